@@ -71,6 +71,7 @@
 #include <memory>
 #include <string>
 #include <cstdlib>
+#include <vector>
 
 // Helper do print out typeinformation...found somewhere on stackoverflow
 template <class T>
@@ -313,6 +314,17 @@ public:
 #endif // FORCE_NO_SINGLE_VISITOR
 
 
+// Optional batch interface of indexed viewers (see BatchValueViewer), void for index types without one.
+// The trait is also the tag argument of the asBatch hook of the viewers, hence the hooks of viewers 
+// with different index types are distinct functions.
+template<typename IndexType>
+struct batch_viewer { using type = void; };
+
+template<typename Batch, typename TViewer>
+Batch* batchInterfaceOf(TViewer* viewer, std::true_type) { return viewer; }
+template<typename Batch, typename TViewer>
+Batch* batchInterfaceOf(TViewer*, std::false_type) { return nullptr; }
+
 #if __cplusplus >= 201703L
 template <typename TVisitor1, typename... TVisitors>
 class VisitorGroup : virtual public TVisitor1, virtual public TVisitors... {
@@ -323,6 +335,12 @@ public:
     using IndexType = typename TVisitor1::IndexType;
     using TypeList = concat_type_list_t<typename TVisitor1::TypeList, typename TVisitors::TypeList...>;
     
+    // Batch interface of the viewer or nullptr, groups including the batch interface return themselves
+    virtual typename batch_viewer<IndexType>::type* asBatch(batch_viewer<IndexType>) {
+        using Batch = typename batch_viewer<IndexType>::type;
+        return batchInterfaceOf<Batch>(this, std::is_base_of<Batch, VisitorGroup>());
+    }
+    
     virtual ~VisitorGroup() =default;
 };
 #else
@@ -338,6 +356,11 @@ public:
     using IndexType = typename TVisitor::IndexType;
     using TypeList = concat_type_list_t<typename TVisitor::TypeList, typename VisitorGroup<TVisitor2, TVisitors...>::TypeList>;
     
+    virtual typename batch_viewer<IndexType>::type* asBatch(batch_viewer<IndexType>) {
+        typedef typename batch_viewer<IndexType>::type Batch;
+        return batchInterfaceOf<Batch>(this, std::is_base_of<Batch, VisitorGroup>());
+    }
+    
     virtual ~VisitorGroup() =default;
 };
 template <typename TVisitor>
@@ -348,11 +371,70 @@ public:
     using IndexType = typename TVisitor::IndexType;
     using TypeList = typename TVisitor::TypeList;
     
+    virtual typename batch_viewer<IndexType>::type* asBatch(batch_viewer<IndexType>) {
+        typedef typename batch_viewer<IndexType>::type Batch;
+        return batchInterfaceOf<Batch>(this, std::is_base_of<Batch, VisitorGroup>());
+    }
+    
     virtual ~VisitorGroup() =default;
 };
 #endif
 
 
+// FlatVisitor generates one class with all the handles of a Visitor or (nested) VisitorGroup.
+// The handles are declared along a single inheritance chain, hence the whole visitor has only one vptr
+// and calling a handle needs no virtual base offset adjustment.
+// Grouped sub interfaces are still available through FlatVisitorView (see below).
+template <typename IndexType_, typename TList>
+class FlatVisitorChain;
+
+// Indexed version
+template <typename IndexType_, typename T, typename... Ts>
+class FlatVisitorChain<IndexType_, type_list<T, Ts...>> : public FlatVisitorChain<IndexType_, type_list<Ts...>> {
+public:
+    using FlatVisitorChain<IndexType_, type_list<Ts...>>::handle;
+    
+    virtual bool handle(IndexType_, T) =0;
+};
+template <typename IndexType_, typename T>
+class FlatVisitorChain<IndexType_, type_list<T>> {
+public:
+    virtual bool handle(IndexType_, T) =0;
+    
+    virtual ~FlatVisitorChain() =default;
+};
+
+// Flat version
+template <typename T, typename... Ts>
+class FlatVisitorChain<void, type_list<T, Ts...>> : public FlatVisitorChain<void, type_list<Ts...>> {
+public:
+    using FlatVisitorChain<void, type_list<Ts...>>::handle;
+    
+    virtual void handle(T) =0;
+};
+template <typename T>
+class FlatVisitorChain<void, type_list<T>> {
+public:
+    virtual void handle(T) =0;
+    
+    virtual ~FlatVisitorChain() =default;
+};
+
+template <class TVisitor>
+class FlatVisitor : public FlatVisitorChain<typename TVisitor::IndexType, unique_type_list_t<typename TVisitor::TypeList>> {
+public:
+    using FlatVisitorChain<typename TVisitor::IndexType, unique_type_list_t<typename TVisitor::TypeList>>::handle;
+    
+    using IndexType = typename TVisitor::IndexType;
+    using TypeList = unique_type_list_t<typename TVisitor::TypeList>;
+    
+    // Flat viewers which also implement the batch interface override this to return it
+    virtual typename batch_viewer<IndexType>::type* asBatch(batch_viewer<IndexType>) { return nullptr; }
+    
+    virtual ~FlatVisitor() =default;
+};
+
+
 template <bool CONST, typename IndexType, class TVisitor>
 class Visitable; 
 
@@ -997,6 +1079,70 @@ auto composedVisitor(Ts&&... ts) -> decltype(ComposedVisitor<TVisitorGroup, Ts..
 }
 
 
+// FreeVisitor for flat visitors: the handles are implemented along the same single inheritance chain.
+template <typename Derived, typename TBase, typename IndexType, typename TList>
+class FlatFreeVisitorChain;
+
+template <typename Derived, typename TBase, typename IndexType>
+class FlatFreeVisitorChain<Derived, TBase, IndexType, type_list<>> : public TBase {
+public:
+    using TBase::handle;
+};
+
+template <typename Derived, typename TBase, typename IndexType, typename T, typename... Ts>
+class FlatFreeVisitorChain<Derived, TBase, IndexType, type_list<T, Ts...>> : public FlatFreeVisitorChain<Derived, TBase, IndexType, type_list<Ts...>> {
+public:
+    using FlatFreeVisitorChain<Derived, TBase, IndexType, type_list<Ts...>>::handle;
+    
+    bool handle(IndexType i, T v) override {
+        return static_cast<Derived*>(this)->operator()(i, v);
+    }
+};
+
+template <typename Derived, typename TBase, typename T, typename... Ts>
+class FlatFreeVisitorChain<Derived, TBase, void, type_list<T, Ts...>> : public FlatFreeVisitorChain<Derived, TBase, void, type_list<Ts...>> {
+public:
+    using FlatFreeVisitorChain<Derived, TBase, void, type_list<Ts...>>::handle;
+    
+    void handle(T v) override {
+        static_cast<Derived*>(this)->operator()(v);
+    }
+};
+
+template <typename Derived, typename TVisitor>
+class FreeVisitorBuilder<Derived, FlatVisitor<TVisitor>> : public FlatFreeVisitorChain<Derived, FlatVisitor<TVisitor>, typename TVisitor::IndexType, typename FlatVisitor<TVisitor>::TypeList> {
+public:
+    using FlatFreeVisitorChain<Derived, FlatVisitor<TVisitor>, typename TVisitor::IndexType, typename FlatVisitor<TVisitor>::TypeList>::handle;
+};
+
+
+// View on a flat visitor as one of its grouped sub interfaces, i.e. `FlatVisitorView<ScalarValueViewer<void>, FlatValueViewer<void>>`.
+// All handles are forwarded to the flat visitor. The view is a small object referencing the visitor and should be created on the stack.
+template <class TVisitor, class TFlatVisitor>
+class FlatVisitorView : public FreeVisitorBuilder<FlatVisitorView<TVisitor, TFlatVisitor>, TVisitor> {
+private:
+    TFlatVisitor& visitor_;
+    
+public:
+    using IndexType = typename TVisitor::IndexType;
+    using TypeList = typename TVisitor::TypeList;
+    
+    FlatVisitorView(TFlatVisitor& visitor): visitor_(visitor) {}
+    
+    template<typename ...Ts>
+    auto operator()(Ts&& ... ts) -> decltype(visitor_.handle(std::forward<Ts>(ts)...)) {
+        return visitor_.handle(std::forward<Ts>(ts)...);
+    }
+    
+    using FreeVisitorBuilder<FlatVisitorView<TVisitor, TFlatVisitor>, TVisitor>::handle;
+};
+
+template <class TVisitor, class TFlatVisitor>
+FlatVisitorView<TVisitor, TFlatVisitor> flatVisitorView(TFlatVisitor& visitor) {
+    return FlatVisitorView<TVisitor, TFlatVisitor>{visitor};
+}
+
+
 // ----------------------------------------------------------------------------
 // Templated visitor with CRTP pattern (Curiously Recurring Template Pattern)
 // to use visitors with full type knowledge for use when types are known (i.e. inside a project)
@@ -1389,6 +1535,10 @@ using ContiguousValueViewer       = VisitorGroup<NumericContiguousValueViewer<In
 // First forward define nested Viewables
 class ViewableMapValue;
 class ViewableListValue;
+template<typename IndexType>
+class EditableView;
+using EditableMapValue = EditableView<MapIndexType>;
+using EditableListValue = EditableView<ListIndexType>;
 
 
 // Explicit template specialization in favor of generation with SingleVisitor base classes...
@@ -1458,10 +1608,125 @@ using ContainerValueViewer = VisitorGroup<ListValueViewer<IndexType>, MapValueVi
 template<typename IndexType>
 using ValueViewer = VisitorGroup<ScalarValueViewer<IndexType>, ContiguousValueViewer<IndexType>, ContainerValueViewer<IndexType>>;
 
+// Same handles as ValueViewer but with a single vptr, use FlatVisitorView to pass it as one of the grouped viewers
+template<typename IndexType>
+using FlatValueViewer = FlatVisitor<ValueViewer<IndexType>>;
+
+
+// --- Batched values ---
+// Optional interface for indexed viewers to handle a run of consecutive elements of the same numeric type with one call.
+// Containers check in iterate whether the viewer additionally implements the BatchValueViewer, 
+// otherwise each element is passed to `handle(index, value)`.
+
+// Indices [first, last) of consecutive list elements
+struct ListIndexRange {
+    ListIndexType first;
+    ListIndexType last;
+};
+// Keys of consecutive map entries
+using MapIndexRange = ContiguousDataView<const std::string*>;
+
+template<typename IndexType>
+struct batch_index_type;
+template<>
+struct batch_index_type<MapIndexType> { using type = MapIndexRange; };
+template<>
+struct batch_index_type<ListIndexType> { using type = ListIndexRange; };
+
+template<typename IndexType>
+using batch_index_type_t = typename batch_index_type<IndexType>::type;
+
+// i.e. `bool handle(ListIndexRange, ContiguousDataView<double>)`
+template<typename IndexType>
+using BatchValueViewer = NumericContiguousValueViewer<batch_index_type_t<IndexType>>;
+
+template<>
+struct batch_viewer<MapIndexType> { using type = BatchValueViewer<MapIndexType>; };
+template<>
+struct batch_viewer<ListIndexType> { using type = BatchValueViewer<ListIndexType>; };
+
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 // Very general values... have to implement a lot
 using ViewableValue = Viewable<void, ValueViewer<void>>;
 
+// Flat interface of a map or list (see ViewableMapValue::flat): references the container and a static table of 
+// functions, which pass the FlatValueViewer to its templated visit and iterate. Containers opt in without a flat 
+// base class, hence without another vptr. A default constructed view is empty and converts to false.
+template<typename IndexType>
+class FlatView {
+public:
+    using Viewer = FlatValueViewer<IndexType>;
+    
+    FlatView() =default;
+    template<typename Container>
+    explicit FlatView(const Container& container): container_(&container), operations_(operationsOf<Container>()) {}
+    
+    explicit operator bool() const { return container_ != nullptr; }
+    
+    size_t size() const { return operations_->size(container_); }
+    void visit(IndexType i, Viewer& viewer) const { operations_->visit(container_, i, viewer); }
+    void iterate(Viewer& viewer) const { operations_->iterate(container_, viewer); }
+    void visit(IndexType i, Viewer&& viewer) const { visit(i, viewer); }
+    void iterate(Viewer&& viewer) const { iterate(viewer); }
+    
+private:
+    struct Operations {
+        size_t (*size)(const void*);
+        void (*visit)(const void*, IndexType, Viewer&);
+        void (*iterate)(const void*, Viewer&);
+    };
+    
+    template<typename Container>
+    static size_t sizeOf(const void* c) {
+        return static_cast<const Container*>(c)->Container::size();
+    }
+    template<typename Container>
+    static void visitOf(const void* c, IndexType i, Viewer& viewer) {
+        static_cast<const Container*>(c)->visit(i, viewer, typename Viewer::TypeList());
+    }
+    template<typename Container>
+    static void iterateOf(const void* c, Viewer& viewer) {
+        static_cast<const Container*>(c)->iterate(viewer, typename Viewer::TypeList());
+    }
+    template<typename Container>
+    static const Operations* operationsOf() {
+        static const Operations operations = {&sizeOf<Container>, &visitOf<Container>, &iterateOf<Container>};
+        return &operations;
+    }
+    
+    const void* container_ = nullptr;
+    const Operations* operations_ = nullptr;
+};
+
+// Flat interface of a single value (see Value::flat)
+template<>
+class FlatView<void> {
+public:
+    using Viewer = FlatValueViewer<void>;
+    
+    FlatView() =default;
+    template<typename T>
+    explicit FlatView(const T& value): value_(&value), visit_(&visitOf<T>) {}
+    
+    explicit operator bool() const { return value_ != nullptr; }
+    
+    void visit(Viewer& viewer) const { visit_(value_, viewer); }
+    void visit(Viewer&& viewer) const { visit(viewer); }
+    
+private:
+    template<typename T>
+    static void visitOf(const void* v, Viewer& viewer) {
+        static_cast<const T*>(v)->visit(viewer);
+    }
+    
+    const void* value_ = nullptr;
+    void (*visit_)(const void*, Viewer&) = nullptr;
+};
+
 // Nested container involve recursion, hence they have to be referred to by reference/pointer and need an explicit virtual destructor
 class ViewableMapValue : public virtual ViewableMap<ValueViewer<MapIndexType>> {
 public:
@@ -1469,6 +1734,38 @@ public:
     using ViewableMap<ValueViewer<MapIndexType>>::iterate;
     using VisitableContainerBase::size;
     
+#if __cplusplus >= 201703L
+    // Lookup by std::string_view, the visitor gets the stored key. The default builds a temporary std::string, 
+    // maps storing their keys override it to look up k as is.
+    virtual void visit(std::string_view k, ValueViewer<MapIndexType>& visitor) const {
+        static_cast<const ViewableMap<ValueViewer<MapIndexType>>&>(*this).visit(std::string(k), visitor);
+    }
+    // Otherwise string literals would be ambiguous
+    void visit(const char* k, ValueViewer<MapIndexType>& visitor) const {
+        visit(std::string_view(k), visitor);
+    }
+#endif
+    
+    // Flat viewers are opt-in: implementations which can pass them to their templated visit and iterate return 
+    // FlatView(*this) here, an empty view otherwise (see visitFlat and iterateFlat)
+    virtual FlatView<MapIndexType> flat() const { return FlatView<MapIndexType>(); }
+    
+    // Lookups with hash = hashMapKey(k) computed once by the caller (see CompiledPath). Maps storing the hashes 
+    // of their keys override them to skip hashing k, the defaults ignore the hash.
+    // Nested container at key k or nullptr, if there is none or the value is of another type
+    virtual const ViewableMapValue* childMap(MapIndexType k, size_t hash) const;
+    virtual const ViewableListValue* childList(MapIndexType k, size_t hash) const;
+    // Same as visit(k, visitor)
+    virtual void visitHashed(MapIndexType k, size_t /*hash*/, ValueViewer<MapIndexType>& visitor) const {
+        static_cast<const ViewableMap<ValueViewer<MapIndexType>>&>(*this).visit(k, visitor);
+    }
+    
+    // Structural fingerprint kept by the map, 0 if it keeps none (see structuralFingerprint)
+    virtual uint64_t fingerprint() const { return 0; }
+    
+    // Editable interface of this map, an empty view if it is read only (see ValueEditor)
+    virtual EditableMapValue editable();
+    
     virtual ~ViewableMapValue() =default;
 };
 class ViewableListValue : public virtual ViewableList<ValueViewer<ListIndexType>> {
@@ -1476,9 +1773,164 @@ public:
     using ViewableList<ValueViewer<ListIndexType>>::visit;
     using ViewableList<ValueViewer<ListIndexType>>::iterate; using VisitableContainerBase::size;
     
+    // Flat viewers are opt-in, see ViewableMapValue::flat
+    virtual FlatView<ListIndexType> flat() const { return FlatView<ListIndexType>(); }
+    
+    // Structural fingerprint kept by the list, 0 if it keeps none (see structuralFingerprint)
+    virtual uint64_t fingerprint() const { return 0; }
+    
+    // Editable interface of this list, an empty view if it is read only (see ValueEditor)
+    virtual EditableListValue editable();
+    
     virtual ~ViewableListValue() =default;
 };
 
+inline const ViewableMapValue* ViewableMapValue::childMap(MapIndexType k, size_t) const {
+    struct ChildViewer: public MapValueViewer<MapIndexType> {
+        const ViewableMapValue* result = nullptr;
+        virtual bool handle(MapIndexType, const ViewableMapValue& v) override {
+            result = &v;
+            return true;
+        }
+    } viewer;
+    static_cast<const ViewableMap<ValueViewer<MapIndexType>>&>(*this).visit(k, viewer);
+    return viewer.result;
+}
+inline const ViewableListValue* ViewableMapValue::childList(MapIndexType k, size_t) const {
+    struct ChildViewer: public ListValueViewer<MapIndexType> {
+        const ViewableListValue* result = nullptr;
+        virtual bool handle(MapIndexType, const ViewableListValue& v) override {
+            result = &v;
+            return true;
+        }
+    } viewer;
+    static_cast<const ViewableMap<ValueViewer<MapIndexType>>&>(*this).visit(k, viewer);
+    return viewer.result;
+}
+
+
+// ----------------------------------------------------------------------------
+// Editors
+//
+// Counterparts of the viewers for in-place mutation. Scalars are passed as T&, arrays as the 
+// std::vector<T>& holding them (elements may be changed, the vector resized or moved from) and nested 
+// containers as their editable interface. Editors are accepted by the non-const visit/iterate 
+// of Value, Map and List and by their editable views, see EditableView.
+// ----------------------------------------------------------------------------
+
+template<typename IndexType>
+using IntegralValueEditor = Visitor<IndexType, long&, size_t&, int&, bool&>;
+template<typename IndexType>
+using FloatingValueEditor = Visitor<IndexType, float&, double&>;
+template<typename IndexType>
+using NumericValueEditor  = VisitorGroup<IntegralValueEditor<IndexType>, FloatingValueEditor<IndexType>>;
+
+template<typename IndexType>
+using StringValueEditor = Visitor<IndexType, std::string&>;
+
+template<typename IndexType>
+using ScalarValueEditor = VisitorGroup<NumericValueEditor<IndexType>, StringValueEditor<IndexType>>;
+
+template<typename IndexType>
+using ContiguousValueEditor = Visitor<IndexType, std::vector<long>&, std::vector<size_t>&, std::vector<int>&, std::vector<float>&, std::vector<double>&, std::vector<unsigned char>&>;
+
+template<typename IndexType>
+using MapValueEditor  = Visitor<IndexType, EditableMapValue&>;
+template<typename IndexType>
+using ListValueEditor = Visitor<IndexType, EditableListValue&>;
+template<typename IndexType>
+using ContainerValueEditor = VisitorGroup<ListValueEditor<IndexType>, MapValueEditor<IndexType>>;
+
+template<typename IndexType>
+using ValueEditor = VisitorGroup<ScalarValueEditor<IndexType>, ContiguousValueEditor<IndexType>, ContainerValueEditor<IndexType>>;
+
+// Only the flat editors are part of the editable interfaces
+template<typename IndexType>
+using FlatValueEditor = FlatVisitor<ValueEditor<IndexType>>;
+
+// Editable interface of a map or list (see ViewableMapValue::editable): references the container and a static 
+// table of functions, which pass the FlatValueEditor to its templated visit and iterate. Like FlatView it is 
+// returned by value, so editing adds no vptr to the containers. A default constructed view is empty and converts 
+// to false, const views still edit the container.
+template<typename IndexType>
+class EditableView {
+public:
+    using Editor = FlatValueEditor<IndexType>;
+    
+    EditableView() =default;
+    template<typename Container>
+    explicit EditableView(Container& container): container_(&container), operations_(operationsOf<Container>()) {}
+    
+    explicit operator bool() const { return container_ != nullptr; }
+    // Member access as through a pointer, i.e. `map.editable()->iterate(editor)`
+    const EditableView* operator->() const { return this; }
+    
+    size_t size() const { return operations_->size(container_); }
+    void visit(IndexType i, Editor& editor) const { operations_->visit(container_, i, editor); }
+    void iterate(Editor& editor) const { operations_->iterate(container_, editor); }
+    void visit(IndexType i, Editor&& editor) const { visit(i, editor); }
+    void iterate(Editor&& editor) const { iterate(editor); }
+    
+private:
+    struct Operations {
+        size_t (*size)(const void*);
+        void (*visit)(void*, IndexType, Editor&);
+        void (*iterate)(void*, Editor&);
+    };
+    
+    template<typename Container>
+    static size_t sizeOf(const void* c) {
+        return static_cast<const Container*>(c)->Container::size();
+    }
+    template<typename Container>
+    static void visitOf(void* c, IndexType i, Editor& editor) {
+        static_cast<Container*>(c)->visit(i, editor, typename Editor::TypeList());
+    }
+    template<typename Container>
+    static void iterateOf(void* c, Editor& editor) {
+        static_cast<Container*>(c)->iterate(editor, typename Editor::TypeList());
+    }
+    template<typename Container>
+    static const Operations* operationsOf() {
+        static const Operations operations = {&sizeOf<Container>, &visitOf<Container>, &iterateOf<Container>};
+        return &operations;
+    }
+    
+    void* container_ = nullptr;
+    const Operations* operations_ = nullptr;
+};
+
+// Editable interface of a single value (see Value::editable)
+template<>
+class EditableView<void> {
+public:
+    using Editor = FlatValueEditor<void>;
+    
+    EditableView() =default;
+    template<typename T>
+    explicit EditableView(T& value): value_(&value), visit_(&visitOf<T>) {}
+    
+    explicit operator bool() const { return value_ != nullptr; }
+    const EditableView* operator->() const { return this; }
+    
+    void visit(Editor& editor) const { visit_(value_, editor); }
+    void visit(Editor&& editor) const { visit(editor); }
+    
+private:
+    template<typename T>
+    static void visitOf(void* v, Editor& editor) {
+        static_cast<T*>(v)->visit(editor);
+    }
+    
+    void* value_ = nullptr;
+    void (*visit_)(void*, Editor&) = nullptr;
+};
+
+using EditableValue = EditableView<void>;
+
+inline EditableMapValue ViewableMapValue::editable() { return EditableMapValue(); }
+inline EditableListValue ViewableListValue::editable() { return EditableListValue(); }
+
 
 
 // class TestViewableMap: public ViewableMapValue
@@ -1652,6 +2104,7 @@ int testExample1()
   // Sizeof viewer is 160 (168 for C++11) - 20 Pointers to different vtables of Visitors and Visitor groups - as well as single visitors... these swallow memory
   // (clang 14, vvtable for 8 classes, vftable for 16 handle overloads + virtual destructuors and baseoffsets, 
   // unfortunately the SingleVistor also get one vtable per each with 3 entries (offset_to_top, RTTI, handle() pointer).
+  // Run `make layout` for a full report (sizeof, vptrs, vtable entries) of all viewers and viewables on Linux.
   std::cout << "Sizeof(viewer): " << sizeof(TestViewer) << std::endl;
   
   // Call some specialized visit to demonstrate specialization in output.
@@ -1727,8 +2180,70 @@ int testExample1()
 #include <variant>
 #include <unordered_map>
 #include <vector>
+#include <functional>
+#include <string_view>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <optional>
+#include <exception>
+#include <stdexcept>
+#include <sstream>
+#include <utility>
+#include <charconv>
+#include <limits>
+#include <cstdio>
+#include <memory_resource>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// Array in a buffer allocated elsewhere (a network receive, mmap or another library), adopted without copying.
+// Copies share the buffer, which is read only. release(data, size) is called once when the last copy is dropped.
+// Viewers get the same ContiguousDataView as for the std::vector alternatives, editors skip them.
+template<typename T>
+class ExternalArray {
+private:
+    std::shared_ptr<const T> owner_;
+    size_t size_ = 0;
+    
+public:
+    ExternalArray() =default;
+    template<typename Release>
+    ExternalArray(const T* data, size_t size, Release release)
+        : owner_(data, [release = std::move(release), size](const T* p) mutable { release(p, size); }), size_(size) {}
+    // Shares the ownership of data, e.g. an aliasing shared_ptr into a larger buffer
+    ExternalArray(std::shared_ptr<const T> data, size_t size): owner_(std::move(data)), size_(size) {}
+    
+    const T* data() const { return owner_.get(); }
+    size_t size() const { return size_; }
+};
 
-using GenericValueHolder = std::variant<long, size_t, int, bool, double, float, std::string, const char*, std::vector<ListIndexType>, std::vector<size_t>, std::vector<int>, std::vector<float>, std::vector<double>, std::vector<unsigned char>, std::shared_ptr<ViewableListValue>, std::shared_ptr<ViewableMapValue>>;
+template<typename T>
+class ToContiguousDataView<ExternalArray<T>> {
+public:
+    using type = ContiguousDataView<T>;
+    
+    inline type operator()(const ExternalArray<T>& v) const noexcept(true) {
+        return {v.data(), v.size()};
+    }
+};
+
+using GenericValueHolder = std::variant<long, size_t, int, bool, double, float, std::string, const char*, std::vector<ListIndexType>, std::vector<size_t>, std::vector<int>, std::vector<float>, std::vector<double>, std::vector<unsigned char>, std::shared_ptr<ViewableListValue>, std::shared_ptr<ViewableMapValue>
+                                      , ExternalArray<ListIndexType>, ExternalArray<size_t>, ExternalArray<int>, ExternalArray<float>, ExternalArray<double>, ExternalArray<unsigned char>>;
 
 
 template<class SmartPointer>
@@ -1738,6 +2253,9 @@ template<typename T>
 struct get_smart_pointer_type<std::shared_ptr<T>> { using type = T;};
 template<typename T>
 struct get_smart_pointer_type<std::unique_ptr<T>> { using type = T;};
+// Non-owning references, e.g. to nodes owned by a Document
+template<typename T>
+struct get_smart_pointer_type<T*> { using type = std::remove_cv_t<T>;};
 
 template<class SmartPointer>
 using get_smart_pointer_type_t = typename get_smart_pointer_type<SmartPointer>::type;
@@ -1750,14 +2268,13 @@ template<typename T, typename Allocator>
 struct get_contiguous_data_type<std::vector<T, Allocator>> { using type = T;};
 template<typename T>
 struct get_contiguous_data_type<ContiguousDataView<T>> { using type = T;};
+template<typename T>
+struct get_contiguous_data_type<ExternalArray<T>> { using type = T;};
 
 template<class ContainerType>
 using get_contiguous_data_type_t = typename get_contiguous_data_type<ContainerType>::type;
 
 
-template<template<typename A, typename B> class Predicate>
-struct predicate_template {};
-
 template<typename A, typename B>
 using test_some_or_convertible = std::integral_constant<bool,
         (std::is_trivial_v<decay_t<A>> 
@@ -1767,229 +2284,5194 @@ using test_some_or_convertible = std::integral_constant<bool,
                 std::is_base_of_v<B, A>
             ) 
         )>;
-        
-        
-template<typename V>
-void callFirstOfType(V&&) {
-    // Nothing matched, do nothing...
-}
+template<typename A, typename B>
+using test_for_smartpointer = std::is_same<get_smart_pointer_type_t<decay_t<A>>, decay_t<B>>; // For smart pointers, we check if the unpacked types equal...
+template<typename A, typename B>
+using test_for_contiguous_data = std::is_same<typename ToContiguousDataView<decay_t<A>>::type, decay_t<B>>; // For smart pointers, we check if the unpacked types equal...
 
-template<
-    typename V, 
-    template<typename A, typename B> class Predicate,
-    typename ... TS, 
-    typename Func, 
-    typename ... MoreFuncs, 
-    std::enable_if_t<is_one_of_v<Predicate, V, TS...>, bool> = true>
-void callFirstOfType(V&& v, predicate_template<Predicate>, type_list<TS...>, Func&& func, MoreFuncs&& ...args) {
-    std::forward<Func>(func)(std::forward<V>(v));
-}
 
-template<
-    typename V, 
-    template<typename A, typename B> class Predicate,
-    typename ... TS, 
-    typename Func, 
-    typename ... MoreFuncs, 
-    std::enable_if_t<!is_one_of_v<Predicate, V, TS...>, bool> = true>
-void callFirstOfType(V&& v, predicate_template<Predicate>, type_list<TS...>, Func&& func, MoreFuncs&& ...args) {
-    callFirstOfType(std::forward<V>(v), std::forward<MoreFuncs>(args)...);
-}
+template<template<typename A, typename B> class Predicate, typename A, typename TList>
+struct is_one_of_type_list;
+template<template<typename A, typename B> class Predicate, typename A, typename... TS>
+struct is_one_of_type_list<Predicate, A, type_list<TS...>> : std::integral_constant<bool, is_one_of_v<Predicate, A, TS...>> {};
 
-// Add default predicate
-template<typename V, typename ... TS, typename ... Args>
-void callFirstOfType(V&& v, type_list<TS...>, Args&& ...args) {
-    callFirstOfType(std::forward<V>(v), predicate_template<test_some_or_convertible>{}, type_list<TS...>{}, std::forward<Args>(args)...);
-}
 
+// ----------------------------------------------------------------------------
+// Dispatch of variant alternatives to viewers
+//
+// For each pair of variant alternative and viewer TypeList it is decided at compile time
+// how the alternative is passed to the viewer. The handlers of all alternatives are stored in a 
+// constexpr table which is indexed with `variant::index()`, hence each value costs one indexed call.
+// ----------------------------------------------------------------------------
 
+enum class AlternativeKind { None, Scalar, CString, Contiguous, Container };
 
+// Strings with another allocator than std::string (e.g. std::pmr::string)
+template<typename T>
+struct is_allocator_string: std::false_type {};
+template<typename Traits, typename Allocator>
+struct is_allocator_string<std::basic_string<char, Traits, Allocator>>: std::bool_constant<!std::is_same_v<std::basic_string<char, Traits, Allocator>, std::string>> {};
+
+template<typename TLIST, typename T>
+constexpr AlternativeKind alternativeKind() {
+    // Check if T is a scalar value
+    if constexpr (is_one_of_type_list<test_some_or_convertible, T, intersect_type_list_t<TLIST, ScalarValueViewer<void>::TypeList>>::value) {
+        return AlternativeKind::Scalar;
+    }
+    // strings with another allocator are passed as const char*
+    else if constexpr (is_allocator_string<T>::value && is_one_of_type_list<test_some_or_convertible, const char*, intersect_type_list_t<TLIST, ScalarValueViewer<void>::TypeList>>::value) {
+        return AlternativeKind::CString;
+    }
+    // if not, check if is T contiguous array
+    else if constexpr (is_one_of_type_list<test_for_contiguous_data, T, intersect_type_list_t<TLIST, ContiguousValueViewer<void>::TypeList>>::value) {
+        return AlternativeKind::Contiguous;
+    }
+    // if not, check if is T is one of the container classes wrapped in a smart pointer.
+    else if constexpr (is_one_of_type_list<test_for_smartpointer, T, intersect_type_list_t<TLIST, ContainerValueViewer<void>::TypeList>>::value) {
+        return AlternativeKind::Container;
+    }
+    else {
+        return AlternativeKind::None;
+    }
+}
 
-template<typename A, typename B>
-using test_for_smartpointer = std::is_same<get_smart_pointer_type_t<decay_t<A>>, decay_t<B>>; // For smart pointers, we check if the unpacked types equal...
-template<typename A, typename B>
-using test_for_contiguous_data = std::is_same<typename ToContiguousDataView<decay_t<A>>::type, decay_t<B>>; // For smart pointers, we check if the unpacked types equal...
-    
+// Passes one alternative to func, as classified by alternativeKind
+template<AlternativeKind kind, typename T, typename Func>
+bool passAlternative(const T& v, Func& func) {
+    if constexpr (kind == AlternativeKind::Scalar) {
+        return func(v);
+    }
+    else if constexpr (kind == AlternativeKind::CString) {
+        return func(v.c_str());
+    }
+    else if constexpr (kind == AlternativeKind::Contiguous) {
+        return func(toContiguousDataView(v));
+    }
+    else if constexpr (kind == AlternativeKind::Container) {
+        return func(*v);
+    }
+    else {
+        return true;
+    }
+}
 
-template<typename VariantType = GenericValueHolder>
-class Value: public CRTPVisitable<ViewableValue, Value<VariantType>> {
-private:
-    VariantType val_;
+template<typename TLIST, typename VariantType, typename Func, typename Indices = std::make_index_sequence<std::variant_size_v<VariantType>>>
+struct VariantDispatchTable;
+
+template<typename TLIST, typename VariantType, typename Func, size_t... Is>
+struct VariantDispatchTable<TLIST, VariantType, Func, std::index_sequence<Is...>> {
+    using Handler = bool(*)(const VariantType&, Func&);
     
-public:
+    // Alternatives not accepted by the viewer
+    static bool skip(const VariantType&, Func&) {
+        return true;
+    }
+    
+    template<size_t I>
+    static bool handle(const VariantType& var, Func& func) {
+        return passAlternative<alternativeKind<TLIST, std::variant_alternative_t<I, VariantType>>()>(*std::get_if<I>(&var), func);
+    }
+    
+    template<size_t I>
+    static constexpr Handler handler() {
+        if constexpr (alternativeKind<TLIST, std::variant_alternative_t<I, VariantType>>() == AlternativeKind::None) {
+            return &skip;
+        }
+        else {
+            return &handle<I>;
+        }
+    }
+    
+    static constexpr Handler table[sizeof...(Is)] = { handler<Is>()... };
+};
+
+template<typename T, typename TList>
+struct is_in_type_list;
+template<typename T, typename... TS>
+struct is_in_type_list<T, type_list<TS...>> : std::integral_constant<bool, is_one_of_v<std::is_same, T, TS...>> {};
+
+// True if TLIST is the TypeList of an editor, i.e. some type is a mutable reference
+template<typename TLIST>
+struct is_editor_type_list;
+template<typename... TS>
+struct is_editor_type_list<type_list<TS...>> : std::integral_constant<bool, (... || (std::is_lvalue_reference_v<TS> && !std::is_const_v<std::remove_reference_t<TS>>))> {};
+
+// Passes one alternative to an editor func. Alternatives are passed if the editor takes them by reference, 
+// nested containers if they are editable. All others are skipped.
+template<typename TLIST, typename T, typename Func>
+bool passEditable(T& v, Func& func) {
+    if constexpr (is_in_type_list<T&, TLIST>::value) {
+        return func(v);
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ViewableMapValue>> && is_in_type_list<EditableMapValue&, TLIST>::value) {
+        EditableMapValue map = v->editable();
+        return map ? func(map) : true;
+    }
+    else if constexpr (std::is_same_v<T, std::shared_ptr<ViewableListValue>> && is_in_type_list<EditableListValue&, TLIST>::value) {
+        EditableListValue list = v->editable();
+        return list ? func(list) : true;
+    }
+    else {
+        return true;
+    }
+}
+
+template<typename TLIST, typename VariantType, typename Func, typename Indices = std::make_index_sequence<std::variant_size_v<VariantType>>>
+struct VariantEditTable;
+
+template<typename TLIST, typename VariantType, typename Func, size_t... Is>
+struct VariantEditTable<TLIST, VariantType, Func, std::index_sequence<Is...>> {
+    using Handler = bool(*)(VariantType&, Func&);
+    
+    template<size_t I>
+    static bool handle(VariantType& var, Func& func) {
+        return passEditable<TLIST>(*std::get_if<I>(&var), func);
+    }
+    
+    static constexpr Handler table[sizeof...(Is)] = { &handle<Is>... };
+};
+
+// Access to the alternatives of the VariantType of Value, Map and List. 
+// Specialize for value types which are not a std::variant.
+template<typename VariantType>
+struct variant_access {
+    template<typename TLIST, typename Func>
+    static bool dispatch(const VariantType& var, Func& func) {
+        using Table = VariantDispatchTable<TLIST, VariantType, Func>;
+        if(var.valueless_by_exception()) return true;
+        return Table::table[var.index()](var, func);
+    }
+    
+    template<typename T>
+    static const T* getIf(const VariantType& var) {
+        return std::get_if<T>(&var);
+    }
+    
+    template<typename TLIST, typename Func>
+    static bool edit(VariantType& var, Func& func) {
+        using Table = VariantEditTable<TLIST, VariantType, Func>;
+        if(var.valueless_by_exception()) return true;
+        return Table::table[var.index()](var, func);
+    }
+};
+
+// Passes the value held by the variant to func (as scalar, ContiguousDataView or container reference).
+// Func returns false if an iteration should be stopped, this is returned to the caller.
+template<typename TLIST, typename VariantType, typename Func>
+bool dispatchVariant(const VariantType& var, Func&& func) {
+    return variant_access<VariantType>::template dispatch<TLIST>(var, func);
+}
+
+// Same as dispatchVariant for editors, the value is passed by mutable reference (scalars and arrays as stored,
+// containers as their editable interface).
+template<typename TLIST, typename VariantType, typename Func>
+bool editVariant(VariantType& var, Func&& func) {
+    return variant_access<VariantType>::template edit<TLIST>(var, func);
+}
+
+
+// Batching of runs with same type in Map::iterate and List::iterate
+// Number of elements collected for one batched handle
+static const size_t batchBufferSize = 256;
+
+template<typename TViewer, typename IndexType, typename = void>
+struct has_batch_hook : std::false_type {};
+template<typename TViewer, typename IndexType>
+struct has_batch_hook<TViewer, IndexType, std::void_t<decltype(std::declval<TViewer&>().asBatch(batch_viewer<IndexType>{}))>> 
+    : std::is_same<decltype(std::declval<TViewer&>().asBatch(batch_viewer<IndexType>{})), BatchValueViewer<IndexType>*> {};
+
+static_assert(has_batch_hook<ValueViewer<ListIndexType>, ListIndexType>::value && has_batch_hook<ValueViewer<MapIndexType>, MapIndexType>::value, 
+    "the batch hook needs batch_viewer to be specialized before the viewers are instantiated");
+
+// Returns the batch interface of the visitor or nullptr if not supported. Known statically if the viewer type derives 
+// from BatchValueViewer, otherwise one virtual call of the asBatch hook of VisitorGroup or FlatVisitor.
+template<typename IndexType, typename TViewer>
+BatchValueViewer<IndexType>* asBatchValueViewer(TViewer& visitor) {
+    if constexpr (std::is_base_of_v<BatchValueViewer<IndexType>, TViewer>) {
+        return &visitor;
+    }
+    else if constexpr (has_batch_hook<TViewer, IndexType>::value) {
+        return visitor.asBatch(batch_viewer<IndexType>{});
+    }
+    else {
+        return nullptr;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Open addressing hash table with string keys (backing store of Map)
+//
+// Entries are stored densely in insertion order, hence iteration is a linear scan. 
+// The slot array only holds the entry index and the upper bits of the hash, which are compared 
+// before the key. Lookups take a std::string_view, so no temporary std::string is built for 
+// literals or slices of a parsed buffer, and a probe does not allocate.
+// ----------------------------------------------------------------------------
+
+// Hash of map keys, shared by all FlatStringMaps. Callers looking up the same key repeatedly compute it once.
+inline size_t hashMapKey(std::string_view k) {
+    return std::hash<std::string_view>{}(k);
+}
+
+template<typename T, typename Allocator = std::allocator<T>>
+class FlatStringMap {
+    template<typename U>
+    using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
+    
+public:
+    using allocator_type = Allocator;
+    // The keys use the allocator of the entries, i.e. std::pmr::string for a std::pmr::polymorphic_allocator
+    using key_type = std::basic_string<char, std::char_traits<char>, rebind_alloc<char>>;
+    using value_type = std::pair<key_type, T>;
+    using iterator = typename std::vector<value_type, rebind_alloc<value_type>>::iterator;
+    using const_iterator = typename std::vector<value_type, rebind_alloc<value_type>>::const_iterator;
+    
+private:
+    struct Slot {
+        uint32_t entry; // Index into entries_ + 1, 0 marks an empty slot
+        uint32_t tag;   // Upper bits of the hash
+    };
+    
+    static constexpr size_t minSlots = 8;
+    
+    std::vector<value_type, rebind_alloc<value_type>> entries_;
+    std::vector<Slot, rebind_alloc<Slot>> slots_; // Empty or a power of two, at most 7/8 are used
+    
+public:
+    FlatStringMap() =default;
+    explicit FlatStringMap(const Allocator& allocator): entries_(rebind_alloc<value_type>(allocator)), slots_(rebind_alloc<Slot>(allocator)) {}
+    FlatStringMap(std::initializer_list<std::pair<const std::string, T>> l): FlatStringMap(l.begin(), l.end()) {}
+    template<typename InputIt>
+    FlatStringMap(InputIt first, InputIt last) {
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            reserve(std::distance(first, last));
+        }
+        for(; first != last; ++first) {
+            // Keys and values of move iterators are moved
+            auto&& entry = *first;
+            emplace(std::forward<decltype(entry)>(entry).first, std::forward<decltype(entry)>(entry).second);
+        }
+    }
+    
+    static size_t hashKey(std::string_view k) {
+        return hashMapKey(k);
+    }
+    
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    const_iterator begin() const { return entries_.begin(); }
+    const_iterator end() const { return entries_.end(); }
+    // Values may be changed through the mutable iterators, keys must not
+    iterator begin() { return entries_.begin(); }
+    iterator end() { return entries_.end(); }
+    
+    void reserve(size_t n) {
+        entries_.reserve(n);
+        size_t slots = minSlots;
+        while(slots * 7 < n * 8) slots *= 2;
+        if(slots > slots_.size()) rehash(slots);
+    }
+    
+    // Returns the entry with key k or nullptr
+    const value_type* find(std::string_view k) const {
+        return find(k, hashKey(k));
+    }
+    const value_type* find(std::string_view k, size_t hash) const {
+        const size_t i = findSlot(k, hash);
+        return i == slots_.size() ? nullptr : &entries_[slots_[i].entry - 1];
+    }
+    
+    value_type* find(std::string_view k) {
+        return const_cast<value_type*>(static_cast<const FlatStringMap&>(*this).find(k));
+    }
+    
+    // Inserts the entry if k is not yet present (like std::unordered_map::emplace), returns true if inserted.
+    // Keys passed as key_type rvalue with the same allocator are moved.
+    template<typename K, typename U>
+    bool emplace(K&& k, U&& value) {
+        const std::string_view key(k);
+        const size_t hash = hashKey(key);
+        if(find(key, hash) != nullptr) return false;
+        if((entries_.size() + 1) * 8 > slots_.size() * 7) {
+            rehash(std::max(minSlots, slots_.size() * 2));
+        }
+        entries_.emplace_back(key_type(std::forward<K>(k), rebind_alloc<char>(entries_.get_allocator())), std::forward<U>(value));
+        insertSlot(hash, entries_.size());
+        return true;
+    }
+    
+    // Inserts or replaces the value of k (like std::unordered_map::insert_or_assign), returns true if inserted
+    template<typename U>
+    bool assign(std::string_view k, U&& value) {
+        if(value_type* entry = find(k)) {
+            entry->second = std::forward<U>(value);
+            return false;
+        }
+        return emplace(k, std::forward<U>(value));
+    }
+    
+    // Removes the entry of k, the following entries keep their order. Its slot is freed by backward shift deletion, 
+    // which hashes only the keys probed behind it. Linear in the number of entries for moving them and for 
+    // renumbering the slots of the following entries.
+    bool erase(std::string_view k) {
+        size_t i = findSlot(k, hashKey(k));
+        if(i == slots_.size()) return false;
+        const uint32_t removed = slots_[i].entry;
+        const size_t mask = slots_.size() - 1;
+        for(size_t j = (i + 1) & mask; slots_[j].entry != 0; j = (j + 1) & mask) {
+            // The slot moves up to i unless that is before its home slot
+            const size_t home = hashKey(entries_[slots_[j].entry - 1].first) & mask;
+            if(((j - home) & mask) >= ((j - i) & mask)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = Slot{0, 0};
+        entries_.erase(entries_.begin() + (removed - 1));
+        if(removed <= entries_.size()) {
+            for(Slot& slot: slots_) {
+                if(slot.entry > removed) --slot.entry;
+            }
+        }
+        return true;
+    }
+    
+private:
+    static uint32_t tagOf(size_t hash) {
+        return static_cast<uint32_t>(hash >> (sizeof(size_t) * 8 - 32));
+    }
+    
+    // Slot of k, slots_.size() if there is none
+    size_t findSlot(std::string_view k, size_t hash) const {
+        if(slots_.empty()) return 0;
+        const size_t mask = slots_.size() - 1;
+        const uint32_t tag = tagOf(hash);
+        for(size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            if(slot.entry == 0) return slots_.size();
+            if(slot.tag == tag && entries_[slot.entry - 1].first == k) return i;
+        }
+    }
+    
+    void insertSlot(size_t hash, size_t entry) {
+        const size_t mask = slots_.size() - 1;
+        size_t i = hash & mask;
+        while(slots_[i].entry != 0) i = (i + 1) & mask;
+        slots_[i] = Slot{static_cast<uint32_t>(entry), tagOf(hash)};
+    }
+    
+    void rehash(size_t slots) {
+        slots_.assign(slots, Slot{0, 0});
+        for(size_t i = 0; i < entries_.size(); ++i) {
+            insertSlot(hashKey(entries_[i].first), i + 1);
+        }
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// Structural fingerprints
+//
+// A 64 bit hash of the content of a container, covering keys, value types, scalar values, strings and the 
+// payload of ContiguousDataViews. Containers with equal fingerprints are equal (up to hash collisions), 
+// hence comparing two trees can skip each pair of subtrees with equal fingerprints. Map and List compute 
+// their fingerprint on first use and keep it until they or a nested container change (see FingerprintCache), 
+// other containers are hashed on each call. Entries of maps are combined independent of their order, 
+// std::string and const char* values are both hashed as strings.
+// ----------------------------------------------------------------------------
+
+inline uint64_t mixFingerprint(uint64_t h, uint64_t v) {
+    // splitmix64 finalizer
+    uint64_t x = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+inline uint64_t hashFingerprintBytes(const void* data, size_t size) {
+    return std::hash<std::string_view>{}(std::string_view(static_cast<const char*>(data), size));
+}
+
+// Type tags of the fingerprint, contiguous data adds contiguousTag to the tag of its element type
+template<typename T>
+constexpr uint64_t fingerprintTag() {
+    if constexpr (std::is_same_v<T, long>) return 1;
+    else if constexpr (std::is_same_v<T, size_t>) return 2;
+    else if constexpr (std::is_same_v<T, int>) return 3;
+    else if constexpr (std::is_same_v<T, bool>) return 4;
+    else if constexpr (std::is_same_v<T, float>) return 5;
+    else if constexpr (std::is_same_v<T, double>) return 6;
+    else if constexpr (std::is_same_v<T, unsigned char>) return 7;
+    else if constexpr (std::is_base_of_v<ViewableMapValue, T>) return 8;
+    else if constexpr (std::is_base_of_v<ViewableListValue, T>) return 9;
+    else return 10; // Strings
+}
+static const uint64_t contiguousTag = 16;
+
+// Fingerprint of one value, containers use their (cached) fingerprint
+template<typename T>
+uint64_t valueFingerprint(const T& v);
+
+inline uint64_t structuralFingerprint(const ViewableMapValue& v);
+inline uint64_t structuralFingerprint(const ViewableListValue& v);
+
+// Lazily computed fingerprint of a container, 0 while unknown.
+// Containers do not know the containers holding them, children may even be shared by several trees, hence 
+// a change cannot be passed on to the cached fingerprints of the ancestors. Instead the cache records the 
+// nested containers the fingerprint was computed from together with their fingerprints, and the cached value 
+// is only used while each of them still has the recorded one. Reading it checks the subtree of containers 
+// (children with a cache of their own check theirs in turn), values are only hashed again below a change.
+// Own changes reset the cache, concurrent readers may share it. Copies start empty, moves take it over.
+class FingerprintCache {
+public:
+    // Nested container, either map or list is set
+    struct Child {
+        const ViewableMapValue* map;
+        const ViewableListValue* list;
+        uint64_t fingerprint;
+    };
+    using Children = std::vector<Child>;
+    
+private:
+    struct RecordedChild {
+        const ViewableMapValue* map;
+        const ViewableListValue* list;
+        std::atomic<uint64_t> fingerprint;
+    };
+    
+    // Readers seeing a changed child compute the same values and store them in place
+    struct State {
+        std::atomic<uint64_t> fingerprint;
+        size_t count;
+        std::unique_ptr<RecordedChild[]> children;
+        
+        State(uint64_t f, const Children& recorded): fingerprint(f), count(recorded.size()), children(new RecordedChild[count]) {
+            for(size_t i = 0; i < count; ++i) {
+                children[i].map = recorded[i].map;
+                children[i].list = recorded[i].list;
+                children[i].fingerprint.store(recorded[i].fingerprint, std::memory_order_relaxed);
+            }
+        }
+        
+        // The fingerprint is loaded after all children are found unchanged, which were stored after it
+        bool valid() const {
+            for(size_t i = 0; i < count; ++i) {
+                const RecordedChild& child = children[i];
+                const uint64_t current = child.map != nullptr ? structuralFingerprint(*child.map) : structuralFingerprint(*child.list);
+                if(current != child.fingerprint.load(std::memory_order_acquire)) return false;
+            }
+            return true;
+        }
+        void update(uint64_t f, const Children& recorded) {
+            if(recorded.size() != count) return;
+            fingerprint.store(f, std::memory_order_relaxed);
+            for(size_t i = 0; i < count; ++i) {
+                children[i].fingerprint.store(recorded[i].fingerprint, std::memory_order_release);
+            }
+        }
+    };
+    
+    mutable std::atomic<State*> state_{nullptr};
+    
+public:
+    FingerprintCache() =default;
+    // The recorded children belong to the copied container, a deep copy has others
+    FingerprintCache(const FingerprintCache&) noexcept {}
+    // The children move along with the content
+    FingerprintCache(FingerprintCache&& other) noexcept: state_(other.state_.exchange(nullptr)) {}
+    FingerprintCache& operator=(const FingerprintCache&) noexcept {
+        reset();
+        return *this;
+    }
+    FingerprintCache& operator=(FingerprintCache&& other) noexcept {
+        if(this != &other) {
+            reset();
+            state_.store(other.state_.exchange(nullptr));
+        }
+        return *this;
+    }
+    ~FingerprintCache() {
+        reset();
+    }
+    
+    // Cached fingerprint, or compute(children) which adds the nested containers to children
+    template<typename Compute>
+    uint64_t get(Compute&& compute) const {
+        State* state = state_.load(std::memory_order_acquire);
+        if(state != nullptr && state->valid()) return state->fingerprint.load(std::memory_order_relaxed);
+        Children children;
+        const uint64_t f = compute(children);
+        if(state != nullptr) {
+            state->update(f, children);
+            return f;
+        }
+        State* computed = new State(f, children);
+        if(!state_.compare_exchange_strong(state, computed, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // Another reader installed the same values
+            delete computed;
+        }
+        return f;
+    }
+    // Called before each change of the container, no reader may be active
+    void reset() noexcept {
+        delete state_.exchange(nullptr);
+    }
+};
+
+// Keeps no fingerprint, fingerprint() returns 0. For containers which are never destroyed (see Document).
+class NoFingerprintCache {
+public:
+    template<typename Compute>
+    uint64_t get(Compute&&) const { return 0; }
+    void reset() noexcept {}
+};
+
+// Storage of Map<VariantType> and List<VariantType>, specialized for the values of a Document
+template<typename VariantType>
+struct container_traits {
+    using allocator_type = std::allocator<VariantType>;
+    using fingerprint_cache = FingerprintCache;
+};
+
+// Fingerprint of one value, nested containers are added to children if given
+template<typename T>
+uint64_t recordFingerprint(const T& v, FingerprintCache::Children* children) {
+    const uint64_t f = valueFingerprint(v);
+    if(children != nullptr) {
+        if constexpr (std::is_base_of_v<ViewableMapValue, T>) children->push_back({&v, nullptr, f});
+        else if constexpr (std::is_base_of_v<ViewableListValue, T>) children->push_back({nullptr, &v, f});
+    }
+    return f;
+}
+
+// Hashes all values of a container, uses the templated iterate of Container if there is one.
+// The nested containers are added to children if given (see FingerprintCache).
+template<typename Container>
+uint64_t computeFingerprint(const Container& container, FingerprintCache::Children* children = nullptr) {
+    uint64_t h;
+    if constexpr (std::is_base_of_v<ViewableMapValue, Container>) {
+        uint64_t entries = 0;
+        auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&entries, children](MapIndexType k, const auto& v) -> bool {
+            // Sum of the entries, independent of the insertion order
+            entries += mixFingerprint(hashFingerprintBytes(k.data(), k.size()), recordFingerprint(v, children));
+            return true;
+        });
+        container.iterate(viewer);
+        h = mixFingerprint(mixFingerprint(fingerprintTag<ViewableMapValue>(), container.size()), entries);
+    }
+    else {
+        h = mixFingerprint(fingerprintTag<ViewableListValue>(), container.size());
+        auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&h, children](ListIndexType, const auto& v) -> bool {
+            h = mixFingerprint(h, recordFingerprint(v, children));
+            return true;
+        });
+        container.iterate(viewer);
+    }
+    // 0 marks an unknown fingerprint
+    return h == 0 ? 1 : h;
+}
+
+// Fingerprint of a container, the cached one if the container provides one
+inline uint64_t structuralFingerprint(const ViewableMapValue& v) {
+    const uint64_t cached = v.fingerprint();
+    return cached != 0 ? cached : computeFingerprint(v);
+}
+inline uint64_t structuralFingerprint(const ViewableListValue& v) {
+    const uint64_t cached = v.fingerprint();
+    return cached != 0 ? cached : computeFingerprint(v);
+}
+
+template<typename T>
+uint64_t valueFingerprint(const T& v) {
+    if constexpr (std::is_base_of_v<ViewableMapValue, T> || std::is_base_of_v<ViewableListValue, T>) {
+        return structuralFingerprint(v);
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &v, sizeof(T));
+        return mixFingerprint(fingerprintTag<T>(), bits);
+    }
+    else if constexpr (std::is_same_v<T, const char*>) {
+        const std::string_view s = v == nullptr ? std::string_view() : std::string_view(v);
+        return mixFingerprint(fingerprintTag<T>(), hashFingerprintBytes(s.data(), s.size()));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        const std::string_view s = v;
+        return mixFingerprint(fingerprintTag<T>(), hashFingerprintBytes(s.data(), s.size()));
+    }
+    else {
+        return mixFingerprint(contiguousTag + fingerprintTag<typename T::type>(), hashFingerprintBytes(v.data, v.size * sizeof(typename T::type)));
+    }
+}
+
+// Equal content, except for the unlikely case of a fingerprint collision
+template<typename Container>
+bool sameStructure(const Container& a, const Container& b) {
+    return &a == &b || (a.size() == b.size() && structuralFingerprint(a) == structuralFingerprint(b));
+}
+
+
+// ----------------------------------------------------------------------------
+// Compact value cell, alternative VariantType for Value, Map and List
+//
+// 16 bytes instead of the 40 bytes of GenericValueHolder. Numbers, bools, c-strings and strings 
+// with up to 14 characters are stored inline, longer strings, arrays and containers out of line 
+// (owned, copies are deep like for std::variant). Inline strings are passed to the viewers as const char*.
+// ----------------------------------------------------------------------------
+
+// Index of T in the alternatives of VariantType, variant_size if T is not an alternative
+template<typename T, typename VariantType, size_t... Is>
+constexpr size_t variantIndexOf(std::index_sequence<Is...>) {
+    size_t index = sizeof...(Is);
+    ((index == sizeof...(Is) && std::is_same_v<T, std::variant_alternative_t<Is, VariantType>> ? (index = Is, true) : false) || ...);
+    return index;
+}
+
+class CompactValue {
+public:
+    // Same alternatives (and indices) as GenericValueHolder
+    using Alternatives = GenericValueHolder;
+    static constexpr size_t maxInlineString = 14;
+    
+private:
+    static constexpr size_t alternatives = std::variant_size_v<Alternatives>;
+    static constexpr uint8_t inlineStringTag = alternatives;
+    
+    template<typename T>
+    static constexpr size_t indexOf = variantIndexOf<T, Alternatives>(std::make_index_sequence<alternatives>{});
+    
+    // Small trivially copyable alternatives are stored in data_, all others are owned through a pointer in data_
+    template<typename T>
+    static constexpr bool isInline = std::is_trivially_copyable_v<T> && sizeof(T) <= 8;
+    
+    alignas(8) unsigned char data_[15];
+    uint8_t tag_;
+    
+public:
+    template<typename T, typename = std::enable_if_t<(indexOf<decay_t<T>> < alternatives)>>
+    CompactValue(T&& v) {
+        construct<decay_t<T>>(std::forward<T>(v));
+    }
+    // Containers derived from ViewableListValue or ViewableMapValue, e.g. std::shared_ptr<List<>>
+    template<typename T, typename = std::enable_if_t<(indexOf<std::shared_ptr<T>> == alternatives)>>
+    CompactValue(std::shared_ptr<T> v) {
+        if constexpr (std::is_base_of_v<ViewableListValue, T>) {
+            construct<std::shared_ptr<ViewableListValue>>(std::move(v));
+        }
+        else {
+            construct<std::shared_ptr<ViewableMapValue>>(std::move(v));
+        }
+    }
+    
+    CompactValue(const CompactValue& other) {
+        copyFrom(other);
+    }
+    // All alternatives are trivially copyable or held by pointer, hence moving is copying the bytes
+    CompactValue(CompactValue&& other) noexcept {
+        std::memcpy(data_, other.data_, sizeof(data_));
+        tag_ = other.tag_;
+        other.reset();
+    }
+    CompactValue& operator=(const CompactValue& other) {
+        if(this != &other) {
+            destroy();
+            reset();
+            copyFrom(other);
+        }
+        return *this;
+    }
+    CompactValue& operator=(CompactValue&& other) noexcept {
+        if(this != &other) {
+            destroy();
+            std::memcpy(data_, other.data_, sizeof(data_));
+            tag_ = other.tag_;
+            other.reset();
+        }
+        return *this;
+    }
+    ~CompactValue() {
+        destroy();
+    }
+    
+    bool isInlineString() const { return tag_ == inlineStringTag; }
+    
+    // Returns the alternative T or nullptr, inline strings are neither std::string nor const char*
+    template<typename T>
+    const T* getIf() const {
+        // indexOf of other types is alternatives, which is the inline string tag
+        static_assert(indexOf<T> < alternatives, "T is no alternative of CompactValue");
+        if(tag_ != indexOf<T>) return nullptr;
+        return &ref<T>();
+    }
+    
+    template<typename TLIST, typename Func>
+    bool dispatch(Func& func) const {
+        return DispatchTable<TLIST, Func>::table[tag_](*this, func);
+    }
+    
+    // Inline strings are moved out of line before they are passed to an editor as std::string&
+    template<typename TLIST, typename Func>
+    bool edit(Func& func) {
+        if(tag_ == inlineStringTag) {
+            if constexpr (!is_in_type_list<std::string&, TLIST>::value) {
+                return true;
+            }
+            outlineString();
+        }
+        return EditTable<TLIST, Func>::table[tag_](*this, func);
+    }
+    
+private:
+    template<typename TLIST, typename Func, typename Indices = std::make_index_sequence<alternatives>>
+    struct DispatchTable;
+    
+    template<typename TLIST, typename Func, size_t... Is>
+    struct DispatchTable<TLIST, Func, std::index_sequence<Is...>> {
+        using Handler = bool(*)(const CompactValue&, Func&);
+        
+        template<size_t I>
+        static bool handle(const CompactValue& value, Func& func) {
+            using T = std::variant_alternative_t<I, Alternatives>;
+            return passAlternative<alternativeKind<TLIST, T>()>(value.ref<T>(), func);
+        }
+        static bool handleInlineString(const CompactValue& value, Func& func) {
+            const char* s = reinterpret_cast<const char*>(value.data_);
+            return passAlternative<alternativeKind<TLIST, const char*>()>(s, func);
+        }
+        
+        static constexpr Handler table[alternatives + 1] = { &handle<Is>..., &handleInlineString };
+    };
+    
+    template<typename TLIST, typename Func, typename Indices = std::make_index_sequence<alternatives>>
+    struct EditTable;
+    
+    template<typename TLIST, typename Func, size_t... Is>
+    struct EditTable<TLIST, Func, std::index_sequence<Is...>> {
+        using Handler = bool(*)(CompactValue&, Func&);
+        
+        template<size_t I>
+        static bool handle(CompactValue& value, Func& func) {
+            return passEditable<TLIST>(value.ref<std::variant_alternative_t<I, Alternatives>>(), func);
+        }
+        
+        static constexpr Handler table[alternatives] = { &handle<Is>... };
+    };
+    
+    template<typename T>
+    const T& ref() const {
+        if constexpr (isInline<T>) {
+            return *std::launder(reinterpret_cast<const T*>(data_));
+        }
+        else {
+            return **std::launder(reinterpret_cast<T* const*>(data_));
+        }
+    }
+    template<typename T>
+    T& ref() {
+        return const_cast<T&>(static_cast<const CompactValue&>(*this).ref<T>());
+    }
+    
+    void outlineString() {
+        auto* s = new std::string(reinterpret_cast<const char*>(data_));
+        new(data_) std::string*(s);
+        tag_ = indexOf<std::string>;
+    }
+    
+    template<typename T, typename U>
+    void construct(U&& v) {
+        if constexpr (std::is_same_v<T, std::string>) {
+            const std::string_view s(v);
+            if(s.size() <= maxInlineString && s.find('\0') == std::string_view::npos) {
+                std::memcpy(data_, s.data(), s.size());
+                data_[s.size()] = '\0';
+                tag_ = inlineStringTag;
+                return;
+            }
+        }
+        if constexpr (isInline<T>) {
+            new(data_) T(std::forward<U>(v));
+        }
+        else {
+            new(data_) T*(new T(std::forward<U>(v)));
+        }
+        tag_ = indexOf<T>;
+    }
+    
+    // Calls func with a null T* of the alternative T with index tag
+    template<typename Func, size_t... Is>
+    static void withAlternative(uint8_t tag, Func&& func, std::index_sequence<Is...>) {
+        ((tag == Is ? (func(static_cast<std::variant_alternative_t<Is, Alternatives>*>(nullptr)), true) : false) || ...);
+    }
+    
+    void copyFrom(const CompactValue& other) {
+        withAlternative(other.tag_, [this, &other](auto type) {
+            using T = std::remove_pointer_t<decltype(type)>;
+            construct<T>(other.ref<T>());
+        }, std::make_index_sequence<alternatives>{});
+        if(other.tag_ == inlineStringTag) {
+            std::memcpy(data_, other.data_, sizeof(data_));
+            tag_ = inlineStringTag;
+        }
+    }
+    
+    void destroy() {
+        withAlternative(tag_, [this](auto type) {
+            using T = std::remove_pointer_t<decltype(type)>;
+            if constexpr (!isInline<T>) {
+                delete &ref<T>();
+            }
+        }, std::make_index_sequence<alternatives>{});
+    }
+    
+    void reset() {
+        new(data_) long(0);
+        tag_ = indexOf<long>;
+    }
+};
+static_assert(sizeof(CompactValue) == 16, "CompactValue is expected to be 16 bytes");
+
+template<>
+struct variant_access<CompactValue> {
+    template<typename TLIST, typename Func>
+    static bool dispatch(const CompactValue& var, Func& func) {
+        return var.dispatch<TLIST>(func);
+    }
+    
+    template<typename T>
+    static const T* getIf(const CompactValue& var) {
+        return var.getIf<T>();
+    }
+    
+    template<typename TLIST, typename Func>
+    static bool edit(CompactValue& var, Func& func) {
+        return var.edit<TLIST>(func);
+    }
+};
+
+
+// Passes a flat viewer to a map or list through the abstract interface. Containers which opted in to flat viewers
+// (see ViewableMapValue::flat) get it directly, all others through a FlatVisitorView on their grouped interface.
+inline void visitFlat(const ViewableMapValue& map, MapIndexType k, FlatValueViewer<MapIndexType>& viewer) {
+    if(const auto flat = map.flat()) flat.visit(k, viewer);
+    else map.visit(k, flatVisitorView<ValueViewer<MapIndexType>>(viewer));
+}
+inline void iterateFlat(const ViewableMapValue& map, FlatValueViewer<MapIndexType>& viewer) {
+    if(const auto flat = map.flat()) flat.iterate(viewer);
+    else map.iterate(flatVisitorView<ValueViewer<MapIndexType>>(viewer));
+}
+inline void visitFlat(const ViewableListValue& list, ListIndexType i, FlatValueViewer<ListIndexType>& viewer) {
+    if(const auto flat = list.flat()) flat.visit(i, viewer);
+    else list.visit(i, flatVisitorView<ValueViewer<ListIndexType>>(viewer));
+}
+inline void iterateFlat(const ViewableListValue& list, FlatValueViewer<ListIndexType>& viewer) {
+    if(const auto flat = list.flat()) flat.iterate(viewer);
+    else list.iterate(flatVisitorView<ValueViewer<ListIndexType>>(viewer));
+}
+
+
+template<typename VariantType = GenericValueHolder>
+class Value: public CRTPVisitable<ViewableValue, Value<VariantType>> {
+private:
+    VariantType val_;
+    
+public:
+    template<typename T>
+    Value(T&& v): val_(std::forward<T>(v)) {}
+    
+    using CRTPVisitable<ViewableValue, Value<VariantType>>::visit;
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(TViewer& visitor, TLIST = TLIST{}) const {
+        dispatchVariant<TLIST>(val_, [&visitor](const auto& v){
+            visitor.handle(v);
+            return true;
+        });
+    }
+    
+    // Flat viewers are passed to the templated visit without a virtual call, see FlatView
+    FlatView<void> flat() const { return FlatView<void>(*this); }
+    
+    // Flat editors are passed to the templated visit without a virtual call, see EditableView
+    EditableValue editable() { return EditableValue(*this); }
+    template<typename TEditor, typename TLIST = typename TEditor::TypeList, typename = std::enable_if_t<is_editor_type_list<TLIST>::value>>
+    void visit(TEditor& editor, TLIST = TLIST{}) {
+        editVariant<TLIST>(val_, [&editor](auto& v){
+            editor.handle(v);
+            return true;
+        });
+    }
+};
+
+
+template<typename VariantType = GenericValueHolder>
+class Map: public CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>, public ViewableMapValue {
+public:
+    using storage_type = FlatStringMap<VariantType, typename container_traits<VariantType>::allocator_type>;
+    
+private:
+    using key_type = typename storage_type::key_type;
+    
+    storage_type val_;
+    typename container_traits<VariantType>::fingerprint_cache fingerprint_;
+    
+public:
+    virtual ~Map() =default;
+    
+    Map(std::initializer_list<std::pair<const std::string, VariantType>> l): val_{l} {}
+    template<typename InputIt>
+    Map(InputIt first, InputIt last): val_(first, last) {}
+    // Adopts the entries, see MapBuilder
+    explicit Map(storage_type entries): val_(std::move(entries)) {}
+    Map(const Map&) =default;
+    Map(Map&&) noexcept =default;
+    
+    // Load rvalue overloads
+    // using ViewableMapValue::visit;
+    // using ViewableMapValue::iterate;
+    // using ViewableMapValue::size;
+    
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::visit;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::iterate;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::size;
+    
+    virtual size_t size() const override{
+        return val_.size();
+    };
+    
+    virtual FlatView<MapIndexType> flat() const override { return FlatView<MapIndexType>(*this); }
+    
+    // Computed on first use, see FingerprintCache
+    virtual uint64_t fingerprint() const override {
+        return fingerprint_.get([this](FingerprintCache::Children& children) {
+            return computeFingerprint(*this, &children);
+        });
+    }
+    
+    // Entry at position i in insertion order
+    const typename storage_type::value_type& entryAt(size_t i) const {
+        return *(val_.begin() + i);
+    }
+    
+    // Value of k or nullptr
+    const VariantType* find(std::string_view k) const {
+        const auto* entry = val_.find(k);
+        return entry == nullptr ? nullptr : &entry->second;
+    }
+    
+    // Mutation, each call resets the cached fingerprint. The containers holding this map see the change 
+    // when they check their cached fingerprints.
+    // Inserts or replaces the value of k, returns true if inserted
+    bool assign(std::string_view k, VariantType v) {
+        fingerprint_.reset();
+        return val_.assign(k, std::move(v));
+    }
+    bool erase(std::string_view k) {
+        fingerprint_.reset();
+        return val_.erase(k);
+    }
+    
+    virtual EditableMapValue editable() override {
+        return EditableMapValue(*this);
+    }
+    
+    // Editing, the values are passed by reference to the editor. Like the mutation methods above each call 
+    // resets the cached fingerprint, nested containers edited through the editor reset their own.
+    // Editors must not insert or erase entries of the map they are iterating.
+    template<typename TEditor, typename TLIST = typename TEditor::TypeList, typename = std::enable_if_t<is_editor_type_list<TLIST>::value>>
+    void visit(std::string_view k, TEditor& editor, TLIST = TLIST{}) {
+        auto* entry = val_.find(k);
+        if(entry == nullptr) return;
+        fingerprint_.reset();
+        editEntry(*entry, editor, TLIST{});
+    }
+    
+    template<typename TEditor, typename TLIST = typename TEditor::TypeList, typename = std::enable_if_t<is_editor_type_list<TLIST>::value>>
+    void iterate(TEditor& editor, TLIST = TLIST{}) {
+        fingerprint_.reset();
+        for(auto& entry: val_) {
+            if(!editEntry(entry, editor, TLIST{})) return;
+        }
+    }
+    
+    // Heterogeneous lookup, the visitor gets the stored key as MapIndexType
+    virtual void visit(std::string_view k, ValueViewer<MapIndexType>& visitor) const override {
+        visit(k, visitor, ValueViewer<MapIndexType>::TypeList{});
+    }
+    template<typename TViewer>
+    void visit(const char* k, TViewer& visitor) const {
+        visit(std::string_view(k), visitor, typename TViewer::TypeList{});
+    }
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(std::string_view k, TViewer& visitor, TLIST = TLIST{}) const {
+        const auto* entry = val_.find(k);
+        if(entry == nullptr) return;
+        handleEntry(viewedKey(entry->first), entry->second, visitor, TLIST{});
+    }
+    
+    // Lookups with the hash of CompiledPath
+    virtual const ViewableMapValue* childMap(MapIndexType k, size_t hash) const override {
+        return child<ViewableMapValue>(k, hash);
+    }
+    virtual const ViewableListValue* childList(MapIndexType k, size_t hash) const override {
+        return child<ViewableListValue>(k, hash);
+    }
+    virtual void visitHashed(MapIndexType k, size_t hash, ValueViewer<MapIndexType>& visitor) const override {
+        const auto* entry = val_.find(k, hash);
+        if(entry == nullptr) return;
+        handleEntry(viewedKey(entry->first), entry->second, visitor, ValueViewer<MapIndexType>::TypeList{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, val_.size(), visitor, TLIST{});
+    }
+    
+    // Iterates the entries [first, last) in insertion order, the bounds are clamped to size(). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(size_t first, size_t last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, size());
+        first = std::min(first, last);
+        // Batches pass the stored keys
+        if constexpr (std::is_same_v<key_type, std::string>) {
+            if(auto* batchVisitor = asBatchValueViewer<MapIndexType>(visitor)) {
+                return iterateBatched(val_.begin() + first, val_.begin() + last, visitor, *batchVisitor, TLIST{});
+            }
+        }
+        for(auto it = val_.begin() + first; it != val_.begin() + last; ++it) {
+            if(!handleEntry(viewedKey(it->first), it->second, visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    // Keys are passed to the viewers as std::string, keys with another allocator are copied (see Document)
+    static decltype(auto) viewedKey(const key_type& k) {
+        if constexpr (std::is_same_v<key_type, std::string>) return (k);
+        else return std::string(k.data(), k.size());
+    }
+    
+    template<typename Container>
+    const Container* child(std::string_view k, size_t hash) const {
+        const auto* entry = val_.find(k, hash);
+        const Container* result = nullptr;
+        if(entry != nullptr) {
+            dispatchVariant<ContainerValueViewer<void>::TypeList>(entry->second, [&result](const auto& v) {
+                if constexpr (std::is_base_of_v<Container, decay_t<decltype(v)>>) result = &v;
+                return true;
+            });
+        }
+        return result;
+    }
+    
+    // Passes one entry to the visitor, returns false if iteration should be stopped
+    template<typename TViewer, typename TLIST>
+    static bool handleEntry(MapIndexType k, const VariantType& value, TViewer& visitor, TLIST) {
+        return dispatchVariant<TLIST>(value, [&k, &visitor](const auto& v){
+            return visitor.handle(k, v);
+        });
+    }
+    template<typename TEditor, typename TLIST>
+    static bool editEntry(typename storage_type::value_type& entry, TEditor& editor, TLIST) {
+        MapIndexType k = viewedKey(entry.first);
+        return editVariant<TLIST>(entry.second, [&k, &editor](auto& v){
+            return editor.handle(k, v);
+        });
+    }
+    
+    // Consecutive entries with the same numeric type are collected and passed to the batch viewer at once
+    template<typename TViewer, typename TLIST>
+    bool iterateBatched(typename storage_type::const_iterator first, typename storage_type::const_iterator last, TViewer& visitor, BatchValueViewer<MapIndexType>& batchVisitor, TLIST) const {
+        for(auto it = first; it != last;) {
+            auto next = std::next(it);
+            bool cont = dispatchVariant<TLIST>(it->second, [&](const auto& v){
+                using T = decay_t<decltype(v)>;
+                if constexpr (is_in_type_list<T, NumericValueViewer<void>::TypeList>::value) {
+                    const std::string* keys[batchBufferSize];
+                    T values[batchBufferSize];
+                    size_t n = 0;
+                    keys[n] = &it->first;
+                    values[n++] = v;
+                    for(; next != last && n < batchBufferSize; ++next) {
+                        const T* nextValue = variant_access<VariantType>::template getIf<T>(next->second);
+                        if(nextValue == nullptr) break;
+                        keys[n] = &next->first;
+                        values[n++] = *nextValue;
+                    }
+                    return batchVisitor.handle(MapIndexRange{keys, n}, ContiguousDataView<T>{values, n});
+                }
+                else {
+                    return visitor.handle(it->first, v);
+                }
+            });
+            if(!cont) return false;
+            it = next;
+        }
+        return true;
+    }
+};
+
+
+template<typename VariantType = GenericValueHolder>
+class List: public CRTPVisitable<ViewableList<ValueViewer<ListIndexType>>, List<VariantType>>, public ViewableListValue {
+public:
+    using storage_type = std::vector<VariantType, typename container_traits<VariantType>::allocator_type>;
+    
+private:
+    storage_type val_;
+    typename container_traits<VariantType>::fingerprint_cache fingerprint_;
+    
+public:
+    virtual ~List() =default;
+    
+    // template<typename ...TS>
+    // List(TS&& ...vs): val_(std::forward<TS>(vs)...) {}
+    List(std::initializer_list<VariantType> l): val_{l} {}
+    template<typename InputIt>
+    List(InputIt first, InputIt last): val_(first, last) {}
+    // Adopts the elements, see ListBuilder
+    explicit List(storage_type values): val_(std::move(values)) {}
+    List(const List&) =default;
+    List(List&&) noexcept =default;
+    
+    // Load rvalue overloads
+    using ViewableListValue::visit;
+    using ViewableListValue::iterate;
+    using ViewableListValue::size;
+    
+    virtual size_t size() const override {
+        return val_.size();
+    };
+    
+    virtual FlatView<ListIndexType> flat() const override { return FlatView<ListIndexType>(*this); }
+    
+    // Computed on first use, see FingerprintCache
+    virtual uint64_t fingerprint() const override {
+        return fingerprint_.get([this](FingerprintCache::Children& children) {
+            return computeFingerprint(*this, &children);
+        });
+    }
+    
+    const VariantType& at(ListIndexType i) const {
+        return val_[i];
+    }
+    
+    // Mutation, each call resets the cached fingerprint (see Map::assign)
+    // Replaces element i, returns false if there is none
+    bool assign(ListIndexType i, VariantType v) {
+        if(i < 0 || i >= (ListIndexType) val_.size()) return false;
+        fingerprint_.reset();
+        val_[i] = std::move(v);
+        return true;
+    }
+    // Replaces the elements [first, last) by values, returns false if the range is invalid
+    bool replaceRange(ListIndexType first, ListIndexType last, std::vector<VariantType> values) {
+        if(first < 0 || first > last || last > (ListIndexType) val_.size()) return false;
+        fingerprint_.reset();
+        const size_t common = std::min<size_t>(last - first, values.size());
+        std::move(values.begin(), values.begin() + common, val_.begin() + first);
+        if(common < values.size()) {
+            val_.insert(val_.begin() + last, std::make_move_iterator(values.begin() + common), std::make_move_iterator(values.end()));
+        }
+        else {
+            val_.erase(val_.begin() + first + common, val_.begin() + last);
+        }
+        return true;
+    }
+    
+    virtual EditableListValue editable() override {
+        return EditableListValue(*this);
+    }
+    
+    // Editing, see Map. Editors must not change the size of the list they are iterating.
+    
+    template<typename TEditor, typename TLIST = typename TEditor::TypeList, typename = std::enable_if_t<is_editor_type_list<TLIST>::value>>
+    void visit(ListIndexType i, TEditor& editor, TLIST = TLIST{}) {
+        if(i < 0 || i >= (ListIndexType) val_.size()) return;
+        fingerprint_.reset();
+        editElement(i, val_[i], editor, TLIST{});
+    }
+    
+    template<typename TEditor, typename TLIST = typename TEditor::TypeList, typename = std::enable_if_t<is_editor_type_list<TLIST>::value>>
+    void iterate(TEditor& editor, TLIST = TLIST{}) {
+        fingerprint_.reset();
+        for(long i = 0; i < (ListIndexType) val_.size(); ++i) {
+            if(!editElement(i, val_[i], editor, TLIST{})) return;
+        }
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(ListIndexType i, TViewer& visitor, TLIST = TLIST{}) const {
+        if(i < 0 || (size_t) i >= val_.size()) return;
+        handleElement(i, val_[i], visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, val_.size(), visitor, TLIST{});
+    }
+    
+    // Iterates the elements [first, last), the bounds are clamped to [0, size()). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(ListIndexType first, ListIndexType last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, (ListIndexType) size());
+        first = std::max<ListIndexType>(first, 0);
+        if(auto* batchVisitor = asBatchValueViewer<ListIndexType>(visitor)) {
+            return iterateBatched(first, last, visitor, *batchVisitor, TLIST{});
+        }
+        for(long i = first; i < last; ++i) {
+            if(!handleElement(i, val_[i], visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    // Passes one element to the visitor, returns false if iteration should be stopped
+    template<typename TViewer, typename TLIST>
+    static bool handleElement(ListIndexType i, const VariantType& value, TViewer& visitor, TLIST) {
+        return dispatchVariant<TLIST>(value, [&i, &visitor](const auto& v){
+            return visitor.handle(i, v);
+        });
+    }
+    template<typename TEditor, typename TLIST>
+    static bool editElement(ListIndexType i, VariantType& value, TEditor& editor, TLIST) {
+        return editVariant<TLIST>(value, [&i, &editor](auto& v){
+            return editor.handle(i, v);
+        });
+    }
+    
+    // Consecutive elements with the same numeric type are collected and passed to the batch viewer at once
+    template<typename TViewer, typename TLIST>
+    bool iterateBatched(ListIndexType first, ListIndexType last, TViewer& visitor, BatchValueViewer<ListIndexType>& batchVisitor, TLIST) const {
+        for(long i = first; i < last;) {
+            long next = i + 1;
+            bool cont = dispatchVariant<TLIST>(val_[i], [&](const auto& v){
+                using T = decay_t<decltype(v)>;
+                if constexpr (is_in_type_list<T, NumericValueViewer<void>::TypeList>::value) {
+                    T values[batchBufferSize];
+                    size_t n = 0;
+                    values[n++] = v;
+                    for(; next < last && n < batchBufferSize; ++next) {
+                        const T* nextValue = variant_access<VariantType>::template getIf<T>(val_[next]);
+                        if(nextValue == nullptr) break;
+                        values[n++] = *nextValue;
+                    }
+                    return batchVisitor.handle(ListIndexRange{i, next}, ContiguousDataView<T>{values, n});
+                }
+                else {
+                    return visitor.handle(i, v);
+                }
+            });
+            if(!cont) return false;
+            i = next;
+        }
+        return true;
+    }
+};
+
+
+// Homogeneous list stored as plain column. Viewers with the batch interface get the whole column 
+// with one call, all others get one handle(i, T) per element.
+template<typename T>
+class ColumnList: public CRTPVisitable<ViewableList<ValueViewer<ListIndexType>>, ColumnList<T>>, public ViewableListValue {
+private:
+    static_assert(!std::is_same_v<T, bool>, "std::vector<bool> is not contiguous");
+    std::vector<T> val_;
+    
+public:
+    virtual ~ColumnList() =default;
+    
+    ColumnList(std::vector<T> column): val_(std::move(column)) {}
+    ColumnList(std::initializer_list<T> l): val_{l} {}
+    template<typename InputIt>
+    ColumnList(InputIt first, InputIt last): val_(first, last) {}
+    
+    // Load rvalue overloads
+    using ViewableListValue::visit;
+    using ViewableListValue::iterate;
+    using ViewableListValue::size;
+    
+    virtual size_t size() const override {
+        return val_.size();
+    };
+    
+    virtual FlatView<ListIndexType> flat() const override { return FlatView<ListIndexType>(*this); }
+    
+    const std::vector<T>& column() const {
+        return val_;
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(ListIndexType i, TViewer& visitor, TLIST = TLIST{}) const {
+        if(i < 0 || (size_t) i >= val_.size()) return;
+        handleElement(i, visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, val_.size(), visitor, TLIST{});
+    }
+    
+    // Iterates the elements [first, last), the bounds are clamped to [0, size()). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(ListIndexType first, ListIndexType last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, (ListIndexType) size());
+        first = std::max<ListIndexType>(first, 0);
+        if constexpr (is_in_type_list<T, NumericValueViewer<void>::TypeList>::value) {
+            if(auto* batchVisitor = asBatchValueViewer<ListIndexType>(visitor)) {
+                if(first >= last) return true;
+                return batchVisitor->handle(ListIndexRange{first, last}, ContiguousDataView<T>{val_.data() + first, size_t(last - first)});
+            }
+        }
+        for(long i = first; i < last; ++i) {
+            if(!handleElement(i, visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    template<typename TViewer, typename TLIST>
+    bool handleElement(ListIndexType i, TViewer& visitor, TLIST) const {
+        auto func = [&i, &visitor](const auto& v){
+            return visitor.handle(i, v);
+        };
+        return passAlternative<alternativeKind<TLIST, T>()>(val_[i], func);
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Builders
+//
+// Construction of Map and List without the copies of initializer_list, whose elements are const.
+// Keys and values are moved into the builder and its storage is adopted by the built container,
+// hence strings and arrays passed as rvalues are never copied.
+// ----------------------------------------------------------------------------
+
+template<typename VariantType = GenericValueHolder>
+class MapBuilder {
+private:
+    typename Map<VariantType>::storage_type entries_;
+    
+public:
+    MapBuilder() =default;
+    explicit MapBuilder(size_t capacity) {
+        entries_.reserve(capacity);
+    }
+    
+    size_t size() const { return entries_.size(); }
+    
+    MapBuilder& reserve(size_t n) {
+        entries_.reserve(n);
+        return *this;
+    }
+    
+    // Adds the entry if key is not yet present, like Map(initializer_list) the first value of a key is kept
+    template<typename K, typename T>
+    MapBuilder& emplace(K&& key, T&& value) {
+        entries_.emplace(std::forward<K>(key), std::forward<T>(value));
+        return *this;
+    }
+    
+    // Adds the pairs of [first, last), keys and values of move iterators are moved
+    template<typename InputIt>
+    MapBuilder& append(InputIt first, InputIt last) {
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            entries_.reserve(entries_.size() + std::distance(first, last));
+        }
+        for(; first != last; ++first) {
+            auto&& entry = *first;
+            emplace(std::forward<decltype(entry)>(entry).first, std::forward<decltype(entry)>(entry).second);
+        }
+        return *this;
+    }
+    
+    // Adds the n pairs returned by generator(i) for i in [0, n)
+    template<typename Generator>
+    MapBuilder& generate(size_t n, Generator&& generator) {
+        entries_.reserve(entries_.size() + n);
+        for(size_t i = 0; i < n; ++i) {
+            auto entry = generator(i);
+            emplace(std::move(entry.first), std::move(entry.second));
+        }
+        return *this;
+    }
+    
+    // The builder is empty afterwards
+    Map<VariantType> build() {
+        return Map<VariantType>(std::exchange(entries_, typename Map<VariantType>::storage_type{}));
+    }
+    std::shared_ptr<Map<VariantType>> buildShared() {
+        return std::make_shared<Map<VariantType>>(std::exchange(entries_, typename Map<VariantType>::storage_type{}));
+    }
+};
+
+template<typename VariantType = GenericValueHolder>
+class ListBuilder {
+private:
+    typename List<VariantType>::storage_type values_;
+    
+public:
+    ListBuilder() =default;
+    explicit ListBuilder(size_t capacity) {
+        values_.reserve(capacity);
+    }
+    
+    size_t size() const { return values_.size(); }
+    
+    ListBuilder& reserve(size_t n) {
+        values_.reserve(n);
+        return *this;
+    }
+    
+    template<typename T>
+    ListBuilder& emplace(T&& value) {
+        values_.emplace_back(std::forward<T>(value));
+        return *this;
+    }
+    
+    // Adds the values of [first, last), values of move iterators are moved
+    template<typename InputIt>
+    ListBuilder& append(InputIt first, InputIt last) {
+        values_.insert(values_.end(), first, last);
+        return *this;
+    }
+    
+    // Adds the n values returned by generator(i) for i in [0, n)
+    template<typename Generator>
+    ListBuilder& generate(size_t n, Generator&& generator) {
+        values_.reserve(values_.size() + n);
+        for(size_t i = 0; i < n; ++i) {
+            values_.emplace_back(generator(i));
+        }
+        return *this;
+    }
+    
+    // The builder is empty afterwards
+    List<VariantType> build() {
+        return List<VariantType>(std::exchange(values_, typename List<VariantType>::storage_type{}));
+    }
+    std::shared_ptr<List<VariantType>> buildShared() {
+        return std::make_shared<List<VariantType>>(std::exchange(values_, typename List<VariantType>::storage_type{}));
+    }
+};
+
+// ----------------------------------------------------------------------------
+// Arena allocated documents
+//
+// All memory of a Document is taken from one Arena, a std::pmr::monotonic_buffer_resource: the Map/List 
+// nodes as well as their entries, keys (std::pmr::string), strings and arrays. Children are referenced 
+// by plain pointers instead of shared_ptr, hence building a tree needs no control blocks or atomic 
+// reference counts and nodes of a tree are close to each other in memory. Dropping the document releases 
+// the buffers of the arena at once, no destructor of a node is run. 
+// Viewers get the keys as std::string, hence each visited entry copies its key (on the stack for keys 
+// within the small string buffer) and strings are passed as const char*.
+// ----------------------------------------------------------------------------
+
+// Memory resource of a Document, counts the bytes taken from the monotonic buffer resource
+class Arena: public std::pmr::memory_resource {
+private:
+    std::pmr::monotonic_buffer_resource resource_;
+    size_t bytesAllocated_ = 0;
+    
+public:
+    explicit Arena(size_t initialBufferSize = 4096): resource_(initialBufferSize) {}
+    Arena(const Arena&) =delete;
+    Arena& operator=(const Arena&) =delete;
+    
+    // Constructs T in the arena, its destructor is never called: T may only own memory of the arena. 
+    // If the constructor throws, the memory is released with the arena.
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    
+    size_t bytesAllocated() const { return bytesAllocated_; }
+    
+private:
+    virtual void* do_allocate(size_t size, size_t alignment) override {
+        void* p = resource_.allocate(size, alignment);
+        bytesAllocated_ += size;
+        return p;
+    }
+    // Memory is only released with the arena
+    virtual void do_deallocate(void*, size_t, size_t) override {}
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+
+// Scalars of GenericValueHolder, strings and arrays as std::pmr types in the arena of the Document, nested 
+// containers as plain pointers to nodes of the same Document. There are no ExternalArray alternatives: 
+// the values are never destroyed, hence their release callback would never run.
+using DocumentValueHolder = std::variant<long, size_t, int, bool, double, float, std::pmr::string, const char*, std::pmr::vector<ListIndexType>, std::pmr::vector<size_t>, std::pmr::vector<int>, std::pmr::vector<float>, std::pmr::vector<double>, std::pmr::vector<unsigned char>, const ViewableListValue*, const ViewableMapValue*>;
+
+// The containers of a Document are never destroyed, hence they keep no fingerprint (it would own heap memory)
+template<>
+struct container_traits<DocumentValueHolder> {
+    using allocator_type = std::pmr::polymorphic_allocator<DocumentValueHolder>;
+    using fingerprint_cache = NoFingerprintCache;
+};
+
+class Document {
+public:
+    using MapType = Map<DocumentValueHolder>;
+    using ListType = List<DocumentValueHolder>;
+    
+private:
+    Arena arena_;
+    const MapType* root_ = nullptr;
+    
+public:
+    explicit Document(size_t initialBufferSize = 4096): arena_(initialBufferSize) {}
+    
+    // Nodes live as long as the document, children have to be created before their parents.
+    // Keys, strings and arrays are copied into the arena.
+    const MapType* createMap(std::initializer_list<std::pair<const std::string, DocumentValueHolder>> l) {
+        return createMap(l.begin(), l.end());
+    }
+    template<typename InputIt>
+    const MapType* createMap(InputIt first, InputIt last) {
+        typename MapType::storage_type entries(allocator());
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            entries.reserve(std::distance(first, last));
+        }
+        for(; first != last; ++first) {
+            entries.emplace(std::string_view(first->first), adopt(first->second));
+        }
+        return arena_.create<MapType>(std::move(entries));
+    }
+    const ListType* createList(std::initializer_list<DocumentValueHolder> l) {
+        return createList(l.begin(), l.end());
+    }
+    template<typename InputIt>
+    const ListType* createList(InputIt first, InputIt last) {
+        typename ListType::storage_type values(allocator());
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<InputIt>::iterator_category>) {
+            values.reserve(std::distance(first, last));
+        }
+        for(; first != last; ++first) {
+            values.push_back(adopt(*first));
+        }
+        return arena_.create<ListType>(std::move(values));
+    }
+    
+    void setRoot(const MapType* root) { root_ = root; }
+    const MapType& root() const { return *root_; }
+    
+    const Arena& arena() const { return arena_; }
+    
+private:
+    std::pmr::polymorphic_allocator<DocumentValueHolder> allocator() {
+        return std::pmr::polymorphic_allocator<DocumentValueHolder>(&arena_);
+    }
+    
+    // Copy of value whose strings and arrays are in the arena
+    DocumentValueHolder adopt(const DocumentValueHolder& value) {
+        return std::visit([this](const auto& v) -> DocumentValueHolder {
+            using T = decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::pmr::string>) return std::pmr::string(v, &arena_);
+            else if constexpr (!std::is_void_v<get_contiguous_data_type_t<T>>) return T(v.begin(), v.end(), &arena_);
+            else return v;
+        }, value);
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// Recursive traversal with one viewer instance for all depths
+//
+// RecursiveViewer owns one map and one list viewer, which descend into nested containers themselves.
+// The position of the current value is tracked in a TraversalContext. Its path only grows if a new 
+// maximal depth is reached, hence a traversal does not allocate per container.
+// ----------------------------------------------------------------------------
+
+struct TraversalPathElement {
+    const std::string* key; // Key of map entries, nullptr for list elements
+    ListIndexType index;    // Index of list elements
+};
+
+class TraversalContext {
+private:
+    template<typename Handler, template<typename IndexType> class TViewer>
+    friend class RecursiveViewer;
+    template<typename Handler, typename Reduce, template<typename IndexType> class TViewer>
+    friend class ParallelTraverser;
+    
+    std::vector<TraversalPathElement> path_;
+    
+public:
+    TraversalContext() { path_.reserve(16); }
+    
+    // Number of containers between the traversed root and the current value
+    size_t depth() const { return path_.size() - 1; }
+    const std::vector<TraversalPathElement>& path() const { return path_; }
+};
+
+// Prints the path of the current value, e.g. `e[3].some data`
+inline std::ostream& operator<<(std::ostream& out, const TraversalContext& context) {
+    for(size_t i = 0; i < context.path().size(); ++i) {
+        const TraversalPathElement& element = context.path()[i];
+        if(element.key == nullptr) {
+            out << "[" << element.index << "]";
+        }
+        else {
+            out << (i == 0 ? "" : ".") << *element.key;
+        }
+    }
+    return out;
+}
+
+template<typename Handler, typename Container, typename = void>
+struct has_traversal_leave: std::false_type {};
+template<typename Handler, typename Container>
+struct has_traversal_leave<Handler, Container, std::void_t<decltype(std::declval<Handler&>().leave(std::declval<const TraversalContext&>(), std::declval<const Container&>()))>>: std::true_type {};
+
+// The handler is called as handler(context, v) for each value:
+//  - Scalar and contiguous values: returning false stops the traversal.
+//  - Nested ViewableMapValue/ViewableListValue: called before descending, returning false skips the container.
+//    If declared, handler.leave(context, container) is called after the children.
+template<typename Handler, template<typename IndexType> class TViewer = ValueViewer>
+class RecursiveViewer {
+private:
+    struct MapEntries {
+        RecursiveViewer* self;
+        
+        template<typename T>
+        bool operator()(MapIndexType k, const T& v) const {
+            return self->handle(TraversalPathElement{&k, 0}, v);
+        }
+    };
+    struct ListElements {
+        RecursiveViewer* self;
+        
+        template<typename T>
+        bool operator()(ListIndexType i, const T& v) const {
+            return self->handle(TraversalPathElement{nullptr, i}, v);
+        }
+    };
+    
+    Handler handler_;
+    TraversalContext context_;
+    bool stopped_ = false;
+    FreeVisitor<TViewer<MapIndexType>, MapEntries> mapViewer_;
+    FreeVisitor<TViewer<ListIndexType>, ListElements> listViewer_;
+    
+public:
+    template<typename H>
+    explicit RecursiveViewer(H&& handler): handler_(std::forward<H>(handler)), mapViewer_(MapEntries{this}), listViewer_(ListElements{this}) {}
+    // Both viewers refer to this instance
+    RecursiveViewer(const RecursiveViewer&) =delete;
+    RecursiveViewer& operator=(const RecursiveViewer&) =delete;
+    
+    // Traverses all values below the container, returns false if the handler stopped the traversal
+    bool traverse(const ViewableMapValue& map) {
+        stopped_ = false;
+        map.iterate(static_cast<TViewer<MapIndexType>&>(mapViewer_));
+        return !stopped_;
+    }
+    bool traverse(const ViewableListValue& list) {
+        stopped_ = false;
+        list.iterate(static_cast<TViewer<ListIndexType>&>(listViewer_));
+        return !stopped_;
+    }
+    
+    Handler& handler() { return handler_; }
+    
+private:
+    template<typename T>
+    bool handle(TraversalPathElement element, const T& v) {
+        context_.path_.push_back(element);
+        handleValue(v);
+        context_.path_.pop_back();
+        return !stopped_;
+    }
+    
+    template<typename T>
+    void handleValue(const T& v) {
+        const TraversalContext& context = context_;
+        if constexpr (std::is_base_of_v<ViewableMapValue, T> || std::is_base_of_v<ViewableListValue, T>) {
+            if(!handler_(context, v)) return;
+            if constexpr (std::is_base_of_v<ViewableMapValue, T>) {
+                v.iterate(static_cast<TViewer<MapIndexType>&>(mapViewer_));
+            }
+            else {
+                v.iterate(static_cast<TViewer<ListIndexType>&>(listViewer_));
+            }
+            if constexpr (has_traversal_leave<Handler, T>::value) {
+                handler_.leave(context, v);
+            }
+        }
+        else {
+            stopped_ = !handler_(context, v);
+        }
+    }
+};
+
+template<template<typename IndexType> class TViewer = ValueViewer, typename Handler>
+RecursiveViewer<decay_t<Handler>, TViewer> recursiveViewer(Handler&& handler) {
+    return RecursiveViewer<decay_t<Handler>, TViewer>(std::forward<Handler>(handler));
+}
+
+
+// ----------------------------------------------------------------------------
+// Compiled paths
+//
+// A path such as `e[3].deep` (the format printed for a TraversalContext) is parsed once into steps holding 
+// the map keys with their hashes and the list indices. Resolving it descends from the root with one lookup 
+// per step, maps are searched with the stored hashes (ViewableMapValue::childMap, childList and visitHashed). 
+// Only the value at the end of the path is passed to the viewer.
+// ----------------------------------------------------------------------------
+
+struct PathStep {
+    std::string key;          // Key of map entries, empty for list elements
+    size_t hash = 0;          // hashMapKey(key)
+    ListIndexType index = -1; // Index of list elements, -1 for map entries
+    
+    bool isIndex() const { return index >= 0; }
+};
+
+class CompiledPath {
+private:
+    std::vector<PathStep> steps_;
+    std::string error_;
+    
+public:
+    CompiledPath() =default;
+    // Keys are separated by '.', indices are written as [i]. '\' escapes the following character of a key.
+    explicit CompiledPath(std::string_view path) {
+        parse(path);
+    }
+    
+    // Appends a step, e.g. for keys with characters of the path syntax
+    CompiledPath& key(std::string_view k) {
+        steps_.push_back(PathStep{std::string(k), hashMapKey(k), -1});
+        return *this;
+    }
+    CompiledPath& index(ListIndexType i) {
+        if(i < 0) error_ = "negative index";
+        steps_.push_back(PathStep{std::string(), 0, i});
+        return *this;
+    }
+    
+    bool valid() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+    const std::vector<PathStep>& steps() const { return steps_; }
+    
+    // Passes the value at the end of the path to the viewer, as visit of the innermost container does. 
+    // Paths ending in a key need a viewer indexed by MapIndexType, paths ending in an index one indexed by ListIndexType.
+    // Returns false if the path is invalid or does not lead to the innermost container or if the viewer has the wrong index type.
+    template<typename TViewer>
+    bool resolve(const ViewableMapValue& root, TViewer& visitor) const {
+        return resolve(&root, nullptr, visitor);
+    }
+    template<typename TViewer>
+    bool resolve(const ViewableListValue& root, TViewer& visitor) const {
+        return resolve(nullptr, &root, visitor);
+    }
+    
+private:
+    bool fail(const char* message, size_t pos) {
+        error_ = std::string(message) + " at offset " + std::to_string(pos);
+        return false;
+    }
+    
+    bool parse(std::string_view path) {
+        if(path.empty()) return fail("empty path", 0);
+        size_t pos = 0;
+        while(pos < path.size()) {
+            if(path[pos] == '[') {
+                const size_t first = ++pos;
+                ListIndexType i = 0;
+                const auto [end, ec] = std::from_chars(path.data() + first, path.data() + path.size(), i);
+                pos = end - path.data();
+                if(ec != std::errc() || path[first] == '-') return fail("invalid index", first);
+                if(pos >= path.size() || path[pos] != ']') return fail("missing ]", pos);
+                ++pos;
+                index(i);
+                continue;
+            }
+            if(pos > 0 && path[pos++] != '.') return fail("expected . or [", pos - 1);
+            std::string k;
+            for(; pos < path.size() && path[pos] != '.' && path[pos] != '['; ++pos) {
+                if(path[pos] == '\\' && pos + 1 < path.size()) ++pos;
+                k += path[pos];
+            }
+            if(k.empty()) return fail("empty key", pos);
+            key(k);
+        }
+        return true;
+    }
+    
+    template<typename TViewer>
+    bool resolve(const ViewableMapValue* map, const ViewableListValue* list, TViewer& visitor) const {
+        if(!valid() || steps_.empty()) return false;
+        for(size_t i = 0; i + 1 < steps_.size(); ++i) {
+            if(!descend(steps_[i], steps_[i + 1].isIndex(), map, list)) return false;
+        }
+        const PathStep& last = steps_.back();
+        if constexpr (std::is_same_v<typename TViewer::IndexType, MapIndexType>) {
+            if(last.isIndex() || map == nullptr) return false;
+            if constexpr (std::is_base_of_v<ValueViewer<MapIndexType>, TViewer>) {
+                map->visitHashed(last.key, last.hash, visitor);
+            }
+            else if constexpr (std::is_base_of_v<FlatValueViewer<MapIndexType>, TViewer>) {
+                visitFlat(*map, last.key, visitor);
+            }
+            else {
+                map->visit(last.key, visitor);
+            }
+            return true;
+        }
+        else {
+            if(!last.isIndex() || list == nullptr) return false;
+            if constexpr (std::is_base_of_v<FlatValueViewer<ListIndexType>, TViewer>) visitFlat(*list, last.index, visitor);
+            else list->visit(last.index, visitor);
+            return true;
+        }
+    }
+    
+    // Replaces the current container with the value at step, which has to be a list if toList is set and a map otherwise
+    static bool descend(const PathStep& step, bool toList, const ViewableMapValue*& map, const ViewableListValue*& list) {
+        const ViewableMapValue* parentMap = map;
+        const ViewableListValue* parentList = list;
+        map = nullptr;
+        list = nullptr;
+        if(step.isIndex()) {
+            if(parentList == nullptr) return false;
+            if(toList) list = child<ViewableListValue>(*parentList, step.index);
+            else map = child<ViewableMapValue>(*parentList, step.index);
+        }
+        else {
+            if(parentMap == nullptr) return false;
+            if(toList) list = parentMap->childList(step.key, step.hash);
+            else map = parentMap->childMap(step.key, step.hash);
+        }
+        return map != nullptr || list != nullptr;
+    }
+    
+    template<typename Container>
+    static const Container* child(const ViewableListValue& parent, ListIndexType i) {
+        const Container* result = nullptr;
+        auto viewer = freeVisitor<Visitor<ListIndexType, const Container&>>([&result](ListIndexType, const Container& v) -> bool {
+            result = &v;
+            return true;
+        });
+        parent.visit(i, viewer);
+        return result;
+    }
+};
+
+// Prints the path in the format accepted by CompiledPath
+inline std::ostream& operator<<(std::ostream& out, const CompiledPath& path) {
+    for(size_t i = 0; i < path.steps().size(); ++i) {
+        const PathStep& step = path.steps()[i];
+        if(step.isIndex()) {
+            out << "[" << step.index << "]";
+            continue;
+        }
+        if(i > 0) out << ".";
+        for(char c: step.key) {
+            if(c == '.' || c == '[' || c == '\\') out << '\\';
+            out << c;
+        }
+    }
+    return out;
+}
+
+
+// ----------------------------------------------------------------------------
+// Tree diff and patch
+//
+// diffTrees traverses two trees side by side and records the changes which turn the first one into the second.
+// Pairs of containers with equal fingerprints are skipped, with cached fingerprints the cost depends on the 
+// changed containers only. Map entries are matched by key. Lists are compared element wise after skipping their 
+// common prefix and suffix, if the remaining ranges differ in length they are recorded as one RangeChanged. 
+// Values are compared by type and fingerprint (see Structural fingerprints). New values which VariantType 
+// cannot hold leave their change incomplete. patchTree applies the changes to a tree of Map/List in place.
+// ----------------------------------------------------------------------------
+
+enum class ChangeKind { Added, Removed, TypeChanged, ValueChanged, RangeChanged };
+
+inline std::ostream& operator<<(std::ostream& out, ChangeKind kind) {
+    switch(kind) {
+        case ChangeKind::Added: return out << "added";
+        case ChangeKind::Removed: return out << "removed";
+        case ChangeKind::TypeChanged: return out << "type changed";
+        case ChangeKind::ValueChanged: return out << "value changed";
+        case ChangeKind::RangeChanged: return out << "range changed";
+    }
+    return out;
+}
+
+template<typename VariantType = GenericValueHolder>
+struct Change {
+    ChangeKind kind = ChangeKind::ValueChanged;
+    CompiledPath path;                  // Changed entry or element, the list for RangeChanged
+    std::optional<VariantType> value{}; // New value of Added, TypeChanged and ValueChanged
+    ListIndexType first = 0;            // RangeChanged: the elements [first, last) are replaced by values
+    ListIndexType last = 0;
+    std::vector<VariantType> values{};
+    bool complete = true;               // False if a new value cannot be held by VariantType, patchTree rejects the change
+};
+
+template<typename VariantType = GenericValueHolder>
+using ChangeSet = std::vector<Change<VariantType>>;
+
+// Copies a value as passed to viewers into VariantType, nested containers are copied deeply into Map/List.
+// Strings become std::string, ContiguousDataViews std::vector. std::nullopt if VariantType cannot hold the value.
+template<typename VariantType = GenericValueHolder, typename T>
+std::optional<VariantType> copyValue(const T& v) {
+    if constexpr (std::is_base_of_v<ViewableMapValue, T> && std::is_constructible_v<VariantType, std::shared_ptr<ViewableMapValue>>) {
+        std::vector<std::pair<std::string, VariantType>> entries;
+        entries.reserve(v.size());
+        bool complete = true;
+        auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&entries, &complete](MapIndexType k, const auto& value) -> bool {
+            auto copy = copyValue<VariantType>(value);
+            if(!copy) return complete = false;
+            entries.emplace_back(k, std::move(*copy));
+            return true;
+        });
+        v.iterate(viewer);
+        if(!complete) return std::nullopt;
+        auto map = std::make_shared<Map<VariantType>>(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+        return VariantType(std::shared_ptr<ViewableMapValue>(std::move(map)));
+    }
+    else if constexpr (std::is_base_of_v<ViewableListValue, T> && std::is_constructible_v<VariantType, std::shared_ptr<ViewableListValue>>) {
+        std::vector<VariantType> elements;
+        elements.reserve(v.size());
+        bool complete = true;
+        auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&elements, &complete](ListIndexType, const auto& value) -> bool {
+            auto copy = copyValue<VariantType>(value);
+            if(!copy) return complete = false;
+            elements.push_back(std::move(*copy));
+            return true;
+        });
+        v.iterate(viewer);
+        if(!complete) return std::nullopt;
+        auto list = std::make_shared<List<VariantType>>(std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+        return VariantType(std::shared_ptr<ViewableListValue>(std::move(list)));
+    }
+    else if constexpr (std::is_arithmetic_v<T> && std::is_constructible_v<VariantType, T>) {
+        return VariantType(v);
+    }
+    else if constexpr (std::is_same_v<T, const char*> && std::is_constructible_v<VariantType, std::string>) {
+        return VariantType(std::string(v == nullptr ? "" : v));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view> && std::is_constructible_v<VariantType, std::string>) {
+        return VariantType(std::string(v));
+    }
+    else if constexpr (!std::is_void_v<typename get_contiguous_data_type<T>::type>) {
+        using Element = typename get_contiguous_data_type<T>::type;
+        if constexpr (std::is_constructible_v<VariantType, std::vector<Element>>) return VariantType(std::vector<Element>(v.data, v.data + v.size));
+        else return std::nullopt;
+    }
+    else {
+        return std::nullopt;
+    }
+}
+
+template<typename VariantType>
+class TreeDiffer {
+private:
+    // Type tag and fingerprint of a value, nested containers are kept to be compared
+    struct Snapshot {
+        uint64_t tag = 0; // 0 if there is no value
+        uint64_t fingerprint = 0;
+        const ViewableMapValue* map = nullptr;
+        const ViewableListValue* list = nullptr;
+        
+        template<typename T>
+        static Snapshot of(const T& v) {
+            Snapshot s;
+            if constexpr (std::is_void_v<typename get_contiguous_data_type<T>::type>) s.tag = fingerprintTag<T>();
+            else s.tag = contiguousTag + fingerprintTag<typename T::type>();
+            s.fingerprint = valueFingerprint(v);
+            if constexpr (std::is_base_of_v<ViewableMapValue, T>) s.map = &v;
+            if constexpr (std::is_base_of_v<ViewableListValue, T>) s.list = &v;
+            return s;
+        }
+        
+        bool operator==(const Snapshot& other) const {
+            return tag == other.tag && fingerprint == other.fingerprint;
+        }
+    };
+    
+    ChangeSet<VariantType>& changes_;
+    
+public:
+    explicit TreeDiffer(ChangeSet<VariantType>& changes): changes_(changes) {}
+    
+    void diffMaps(const ViewableMapValue& from, const ViewableMapValue& to, const CompiledPath& path) {
+        if(sameStructure(from, to)) return;
+        Snapshot probed;
+        auto probe = freeVisitor<ValueViewer<MapIndexType>>([&probed](MapIndexType, const auto& v) -> bool {
+            probed = Snapshot::of(v);
+            return true;
+        });
+        // Entries of from are removed or changed
+        auto fromViewer = freeVisitor<ValueViewer<MapIndexType>>([&](MapIndexType k, const auto& v) -> bool {
+            const Snapshot before = Snapshot::of(v);
+            probed = Snapshot();
+            to.visit(k, probe);
+            const Snapshot after = probed;
+            CompiledPath entryPath = path;
+            entryPath.key(k);
+            if(after.tag == 0) {
+                record(ChangeKind::Removed, std::move(entryPath));
+            }
+            else {
+                compare(before, after, entryPath, [&to, &k]() { return copyEntry(to, k); });
+            }
+            return true;
+        });
+        from.iterate(fromViewer);
+        // Entries only in to are added
+        auto toViewer = freeVisitor<ValueViewer<MapIndexType>>([&](MapIndexType k, const auto& v) -> bool {
+            probed = Snapshot();
+            from.visit(k, probe);
+            if(probed.tag == 0) {
+                CompiledPath entryPath = path;
+                entryPath.key(k);
+                record(ChangeKind::Added, std::move(entryPath), copyValue<VariantType>(v));
+            }
+            return true;
+        });
+        to.iterate(toViewer);
+    }
+    
+    void diffLists(const ViewableListValue& from, const ViewableListValue& to, const CompiledPath& path) {
+        if(sameStructure(from, to)) return;
+        const std::vector<Snapshot> before = snapshots(from);
+        const std::vector<Snapshot> after = snapshots(to);
+        size_t prefix = 0;
+        while(prefix < before.size() && prefix < after.size() && before[prefix] == after[prefix]) ++prefix;
+        size_t suffix = 0;
+        while(suffix < before.size() - prefix && suffix < after.size() - prefix && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) ++suffix;
+        if(before.size() == after.size()) {
+            for(size_t i = prefix; i < before.size() - suffix; ++i) {
+                CompiledPath elementPath = path;
+                elementPath.index(i);
+                compare(before[i], after[i], elementPath, [&to, i]() { return copyElement(to, i); });
+            }
+            return;
+        }
+        Change<VariantType> change;
+        change.kind = ChangeKind::RangeChanged;
+        change.path = path;
+        change.first = prefix;
+        change.last = before.size() - suffix;
+        for(size_t i = prefix; i < after.size() - suffix && change.complete; ++i) {
+            auto copy = copyElement(to, i);
+            if(copy) change.values.push_back(std::move(*copy));
+            else change.complete = false;
+        }
+        if(!change.complete) change.values.clear();
+        changes_.push_back(std::move(change));
+    }
+    
+private:
+    // Removed changes have no value, the others are incomplete without one
+    void record(ChangeKind kind, CompiledPath path, std::optional<VariantType> value = std::nullopt) {
+        Change<VariantType> change;
+        change.kind = kind;
+        change.path = std::move(path);
+        change.complete = kind == ChangeKind::Removed || value.has_value();
+        change.value = std::move(value);
+        changes_.push_back(std::move(change));
+    }
+    
+    template<typename Copy>
+    void compare(const Snapshot& before, const Snapshot& after, const CompiledPath& path, Copy copy) {
+        if(before.tag != after.tag) {
+            record(ChangeKind::TypeChanged, path, copy());
+        }
+        else if(before.fingerprint == after.fingerprint) {
+            return;
+        }
+        else if(before.map != nullptr) {
+            diffMaps(*before.map, *after.map, path);
+        }
+        else if(before.list != nullptr) {
+            diffLists(*before.list, *after.list, path);
+        }
+        else {
+            record(ChangeKind::ValueChanged, path, copy());
+        }
+    }
+    
+    static std::vector<Snapshot> snapshots(const ViewableListValue& list) {
+        std::vector<Snapshot> result;
+        result.reserve(list.size());
+        auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&result](ListIndexType, const auto& v) -> bool {
+            result.push_back(Snapshot::of(v));
+            return true;
+        });
+        list.iterate(viewer);
+        return result;
+    }
+    
+    static std::optional<VariantType> copyEntry(const ViewableMapValue& map, MapIndexType k) {
+        std::optional<VariantType> result;
+        auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&result](MapIndexType, const auto& v) -> bool {
+            result = copyValue<VariantType>(v);
+            return true;
+        });
+        map.visit(k, viewer);
+        return result;
+    }
+    static std::optional<VariantType> copyElement(const ViewableListValue& list, ListIndexType i) {
+        std::optional<VariantType> result;
+        auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&result](ListIndexType, const auto& v) -> bool {
+            result = copyValue<VariantType>(v);
+            return true;
+        });
+        list.visit(i, viewer);
+        return result;
+    }
+};
+
+// Changes which turn from into to, in traversal order of from followed by the added entries of each map
+template<typename VariantType = GenericValueHolder>
+ChangeSet<VariantType> diffTrees(const ViewableMapValue& from, const ViewableMapValue& to) {
+    ChangeSet<VariantType> changes;
+    TreeDiffer<VariantType>(changes).diffMaps(from, to, CompiledPath());
+    return changes;
+}
+
+// Container held by value, if it is a Map<VariantType> or List<VariantType>. Containers are held by std::shared_ptr 
+// to a non-const container, hence they can be changed through a const value.
+template<typename Container, typename Base, typename VariantType>
+Container* mutableContainer(const VariantType& value) {
+    const auto* pointer = variant_access<VariantType>::template getIf<std::shared_ptr<Base>>(value);
+    return pointer == nullptr ? nullptr : dynamic_cast<Container*>(pointer->get());
+}
+
+// Applies one change of diffTrees, returns false if its path does not exist in root
+template<typename VariantType>
+bool patchTree(Map<VariantType>& root, Change<VariantType>&& change) {
+    const std::vector<PathStep>& steps = change.path.steps();
+    const bool toList = change.kind == ChangeKind::RangeChanged;
+    if(!change.complete || !change.path.valid() || (steps.empty() && !toList)) return false;
+    // Only the container holding the change is changed, its ancestors see it when checking their cached fingerprints
+    Map<VariantType>* map = &root;
+    List<VariantType>* list = nullptr;
+    for(size_t i = 0; i < steps.size() - (toList ? 0 : 1); ++i) {
+        const VariantType* value = nullptr;
+        if(steps[i].isIndex()) {
+            if(list != nullptr && steps[i].index >= 0 && (size_t) steps[i].index < list->size()) value = &list->at(steps[i].index);
+        }
+        else if(map != nullptr) {
+            value = map->find(steps[i].key);
+        }
+        if(value == nullptr) return false;
+        map = mutableContainer<Map<VariantType>, ViewableMapValue>(*value);
+        list = mutableContainer<List<VariantType>, ViewableListValue>(*value);
+    }
+    if(toList) {
+        return list != nullptr && list->replaceRange(change.first, change.last, std::move(change.values));
+    }
+    const PathStep& last = steps.back();
+    if(change.kind == ChangeKind::Removed) {
+        if(last.isIndex()) return list != nullptr && list->replaceRange(last.index, last.index + 1, {});
+        return map != nullptr && map->erase(last.key);
+    }
+    if(!change.value) return false;
+    if(last.isIndex()) {
+        return list != nullptr && list->assign(last.index, std::move(*change.value));
+    }
+    if(map == nullptr) return false;
+    map->assign(last.key, std::move(*change.value));
+    return true;
+}
+
+// Applies the changes of diffTrees in place. Containers on the paths have to be Map<VariantType> and List<VariantType>
+// held by std::shared_ptr, containers shared with other trees are changed as well (this includes the values of copied 
+// change sets). Stops at the first change whose path does not exist or which is incomplete, the previous changes stay applied.
+template<typename VariantType>
+bool patchTree(Map<VariantType>& root, ChangeSet<VariantType> changes) {
+    for(auto& change: changes) {
+        if(!patchTree(root, std::move(change))) return false;
+    }
+    return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// Work stealing thread pool and parallel iteration
+//
+// Each worker has its own task deque. Tasks are pushed to and popped from the back of the own deque 
+// and stolen from the front of the others. Threads waiting for a TaskGroup execute pending tasks 
+// meanwhile, hence task groups can be nested without blocking workers.
+// ----------------------------------------------------------------------------
+
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+    
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    // Queue of the calling thread, threads outside of the pool use the last queue
+    static thread_local const ThreadPool* currentPool_;
+    static thread_local size_t currentQueue_;
+    
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> pending_{0};
+    std::atomic<bool> stop_{false};
+    std::mutex sleepMutex_;
+    std::condition_variable wakeUp_;
+    
+public:
+    explicit ThreadPool(size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency())) {
+        for(size_t i = 0; i <= threads; ++i) {
+            queues_.emplace_back(std::make_unique<Queue>());
+        }
+        for(size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back([this, i]{ work(i); });
+        }
+    }
+    ThreadPool(const ThreadPool&) =delete;
+    ThreadPool& operator=(const ThreadPool&) =delete;
+    
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stop_ = true;
+        }
+        wakeUp_.notify_all();
+        for(auto& thread: threads_) {
+            thread.join();
+        }
+    }
+    
+    size_t size() const { return threads_.size(); }
+    
+    // Queue of the calling worker in [0, size()), size() for all other threads. Several threads share the last 
+    // queue and a worker may run nested tasks, hence it does not identify a thread or an exclusive context.
+    size_t workerIndex() const {
+        return currentPool_ == this ? currentQueue_ : threads_.size();
+    }
+    
+    void submit(Task task) {
+        // Counted before it is visible, hence pending_ never underflows when the task is taken immediately
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            ++pending_;
+        }
+        Queue& queue = *queues_[workerIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        wakeUp_.notify_one();
+    }
+    
+    // Executes one task of the own queue or steals one, returns false if no task was found
+    bool runPendingTask() {
+        const size_t own = workerIndex();
+        Task task;
+        if(!pop(own, task)) {
+            for(size_t i = 1; i < queues_.size() && !task; ++i) {
+                steal((own + i) % queues_.size(), task);
+            }
+        }
+        if(!task) return false;
+        --pending_;
+        task();
+        return true;
+    }
+    
+private:
+    bool pop(size_t index, Task& task) {
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+    
+    bool steal(size_t index, Task& task) {
+        Queue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    
+    void work(size_t index) {
+        currentPool_ = this;
+        currentQueue_ = index;
+        while(true) {
+            if(runPendingTask()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wakeUp_.wait(lock, [this]{ return stop_ || pending_ > 0; });
+            if(stop_ && pending_ == 0) return;
+        }
+    }
+};
+
+inline thread_local const ThreadPool* ThreadPool::currentPool_ = nullptr;
+inline thread_local size_t ThreadPool::currentQueue_ = 0;
+
+
+// Tasks spawned in a group are waited for together. An exception thrown by a task is kept and rethrown by wait, 
+// the worker running the task is not affected.
+class TaskGroup {
+private:
+    ThreadPool& pool_;
+    std::atomic<size_t> open_{0};
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+    
+    // Decrements the open tasks when a task is left, also by an exception
+    struct Done {
+        std::atomic<size_t>& open;
+        ~Done() { --open; }
+    };
+    
+public:
+    explicit TaskGroup(ThreadPool& pool): pool_(pool) {}
+    TaskGroup(const TaskGroup&) =delete;
+    TaskGroup& operator=(const TaskGroup&) =delete;
+    // An exception not rethrown by wait is dropped
+    ~TaskGroup() { join(); }
+    
+    template<typename Func>
+    void spawn(Func&& func) {
+        ++open_;
+        pool_.submit([this, func = std::forward<Func>(func)]() mutable {
+            Done done{open_};
+            try {
+                func();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(errorMutex_);
+                if(!error_) error_ = std::current_exception();
+            }
+        });
+    }
+    
+    // Executes pending tasks of the pool until all tasks of the group are done, 
+    // then rethrows the first exception thrown by a task
+    void wait() {
+        join();
+        if(error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+    
+    ThreadPool& pool() { return pool_; }
+    
+private:
+    void join() {
+        while(open_ > 0) {
+            if(!pool_.runPendingTask()) std::this_thread::yield();
+        }
+    }
+};
+
+
+// Iterates a container with iterateRange (List, Map, ColumnList) in chunks on the pool.
+// Each chunk is handled by its own copy of the visitor, at the end reduce(visitor, clone) is called for all clones 
+// in the order of the chunks, hence the result does not depend on the scheduling (as for ParallelTraverser).
+// Clones are not shared by threads, which also holds for several callers outside of the pool and for chunks 
+// run by a worker while it waits in a nested task group. Visitors have to hold their state by value, 
+// references (e.g. captured by a lambda) are shared by all clones.
+// If a clone stops the iteration, chunks not yet started are skipped. Returns false in that case.
+// An exception of the visitor is rethrown after all started chunks are done.
+template<typename Container, typename TViewer, typename Reduce, typename TLIST = typename TViewer::TypeList>
+bool parallelIterate(ThreadPool& pool, const Container& container, TViewer& visitor, Reduce&& reduce, size_t chunkSize = 0, TLIST = TLIST{}) {
+    const size_t size = container.size();
+    if(chunkSize == 0) {
+        // Some chunks per worker to balance the load
+        chunkSize = std::max<size_t>(1024, size / (4 * (pool.size() + 1)) + 1);
+    }
+    
+    std::vector<std::optional<TViewer>> clones((size + chunkSize - 1) / chunkSize);
+    std::atomic<bool> stopped{false};
+    {
+        TaskGroup group(pool);
+        for(size_t chunk = 0; chunk < clones.size(); ++chunk) {
+            const size_t first = chunk * chunkSize;
+            const size_t last = std::min(size, first + chunkSize);
+            group.spawn([&, chunk, first, last]{
+                if(stopped) return;
+                auto& clone = clones[chunk].emplace(static_cast<const TViewer&>(visitor));
+                if(!container.iterateRange(first, last, clone, TLIST{})) stopped = true;
+            });
+        }
+        group.wait();
+    }
+    
+    for(auto& clone: clones) {
+        if(clone) reduce(visitor, *clone);
+    }
+    return !stopped;
+}
+
+
+// Parallel traversal of nested containers. Child containers with at least spawnThreshold values become 
+// tasks of the pool, smaller ones are traversed inline.
+// The handler is called as for RecursiveViewer. Each task and each run of values between spawned children 
+// is handled by its own copy of the prototype handler, all copies are combined with reduce(into, from) 
+// in document order, hence the result does not depend on the scheduling.
+template<typename Handler, typename Reduce, template<typename IndexType> class TViewer>
+class ParallelTraverser {
+public:
+    struct Shared {
+        ThreadPool& pool;
+        const Handler& prototype;
+        const Reduce& reduce;
+        size_t spawnThreshold;
+        std::atomic<bool> stopped{false};
+    };
+    
+private:
+    struct MapEntries {
+        ParallelTraverser* self;
+        
+        template<typename T>
+        bool operator()(MapIndexType k, const T& v) const {
+            return self->handle(TraversalPathElement{&k, 0}, v);
+        }
+    };
+    struct ListElements {
+        ParallelTraverser* self;
+        
+        template<typename T>
+        bool operator()(ListIndexType i, const T& v) const {
+            return self->handle(TraversalPathElement{nullptr, i}, v);
+        }
+    };
+    
+    Shared& shared_;
+    TraversalContext context_;
+    // Own runs of values and results of spawned children in document order, references stay valid on emplace_back
+    std::deque<std::optional<Handler>> parts_;
+    Handler* current_ = nullptr;
+    TaskGroup group_;
+    FreeVisitor<TViewer<MapIndexType>, MapEntries> mapViewer_;
+    FreeVisitor<TViewer<ListIndexType>, ListElements> listViewer_;
+    
+public:
+    ParallelTraverser(Shared& shared, TraversalContext context): shared_(shared), context_(std::move(context)), group_(shared.pool), mapViewer_(MapEntries{this}), listViewer_(ListElements{this}) {
+        startRun();
+    }
+    ParallelTraverser(const ParallelTraverser&) =delete;
+    ParallelTraverser& operator=(const ParallelTraverser&) =delete;
+    
+    // Traverses all values below the container, returns the combined handler
+    template<typename Container>
+    Handler run(const Container& container) {
+        iterateChildren(container);
+        group_.wait();
+        Handler result = std::move(*parts_.front());
+        for(auto it = std::next(parts_.begin()); it != parts_.end(); ++it) {
+            if(*it) shared_.reduce(result, **it);
+        }
+        return result;
+    }
+    
+private:
+    void startRun() {
+        current_ = &parts_.emplace_back(shared_.prototype).value();
+    }
+    
+    void iterateChildren(const ViewableMapValue& map) {
+        map.iterate(static_cast<TViewer<MapIndexType>&>(mapViewer_));
+    }
+    void iterateChildren(const ViewableListValue& list) {
+        list.iterate(static_cast<TViewer<ListIndexType>&>(listViewer_));
+    }
+    
+    template<typename T>
+    bool handle(TraversalPathElement element, const T& v) {
+        if(shared_.stopped) return false;
+        context_.path_.push_back(element);
+        handleValue(v);
+        context_.path_.pop_back();
+        return !shared_.stopped;
+    }
+    
+    template<typename T>
+    void handleValue(const T& v) {
+        const TraversalContext& context = context_;
+        if constexpr (std::is_base_of_v<ViewableMapValue, T> || std::is_base_of_v<ViewableListValue, T>) {
+            if(!(*current_)(context, v)) return;
+            if(v.size() >= shared_.spawnThreshold) {
+                spawn(v);
+                startRun();
+            }
+            else {
+                iterateChildren(v);
+            }
+            if constexpr (has_traversal_leave<Handler, T>::value) {
+                current_->leave(context, v);
+            }
+        }
+        else {
+            if(!(*current_)(context, v)) shared_.stopped = true;
+        }
+    }
+    
+    template<typename Container>
+    void spawn(const Container& container) {
+        auto& slot = parts_.emplace_back();
+        Shared& shared = shared_;
+        group_.spawn([&shared, &slot, &container, context = context_]() mutable {
+            if(shared.stopped) return;
+            ParallelTraverser traverser(shared, std::move(context));
+            slot.emplace(traverser.run(container));
+        });
+    }
+};
+
+template<template<typename IndexType> class TViewer = ValueViewer, typename Container, typename Handler, typename Reduce>
+Handler parallelTraverse(ThreadPool& pool, const Container& root, const Handler& prototype, Reduce&& reduce, size_t spawnThreshold = 16) {
+    using Traverser = ParallelTraverser<Handler, decay_t<Reduce>, TViewer>;
+    typename Traverser::Shared shared{pool, prototype, reduce, spawnThreshold};
+    Traverser traverser(shared, TraversalContext{});
+    return traverser.run(static_cast<const conditional_t<std::is_base_of_v<ViewableMapValue, Container>, ViewableMapValue, ViewableListValue>&>(root));
+}
+
+
+// ----------------------------------------------------------------------------
+// Snapshot published maps (read-copy-update)
+//
+// Readers visit an immutable version of the map without locks or reference counting, they only 
+// announce the current epoch in a slot of their own. Writers publish a new version with one atomic 
+// exchange. Replaced versions are retired with the epoch of their replacement and deleted, once no 
+// reader has announced an older epoch: by the next writer or by a reader leaving its read section while 
+// versions are pending and the write lock is free (readers never wait for it).
+// ----------------------------------------------------------------------------
+
+class EpochDomain {
+public:
+    // Slots allocated with the domain, further readers add slots to an overflow list
+    static constexpr size_t fixedSlots = 256;
+    
+private:
+    // One cache line per reader, 0 if the reader is outside of a read section
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> used{false};
+        Slot* next = nullptr; // Next overflow slot, set before the slot is linked
+    };
+    
+    // Slot of a thread, released when the thread exits
+    struct ThreadSlot {
+        Slot* slot = nullptr;
+        size_t nesting = 0;
+        
+        ~ThreadSlot() {
+            if(slot != nullptr) slot->used.store(false);
+        }
+    };
+    
+    std::atomic<uint64_t> epoch_{1};
+    Slot slots_[fixedSlots];
+    // Overflow slots are only added (lock-free push) and reused, they are deleted with the domain
+    std::atomic<Slot*> overflow_{nullptr};
+    
+    EpochDomain() =default;
+    ~EpochDomain() {
+        for(Slot* slot = overflow_.load(); slot != nullptr;) {
+            delete std::exchange(slot, slot->next);
+        }
+    }
+    
+    static bool tryAcquire(Slot& slot) {
+        bool expected = false;
+        return slot.used.compare_exchange_strong(expected, true);
+    }
+    
+    Slot* acquireSlot() {
+        for(Slot& slot: slots_) {
+            if(tryAcquire(slot)) return &slot;
+        }
+        for(Slot* slot = overflow_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            if(tryAcquire(*slot)) return slot;
+        }
+        // All slots are used by live threads, a new one is pushed to the overflow list
+        Slot* slot = new Slot;
+        slot->used.store(true, std::memory_order_relaxed);
+        slot->next = overflow_.load(std::memory_order_relaxed);
+        while(!overflow_.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {}
+        return slot;
+    }
+    
+    ThreadSlot& threadSlot() {
+        static thread_local ThreadSlot slot;
+        if(slot.slot == nullptr) slot.slot = acquireSlot();
+        return slot;
+    }
+    
+public:
+    EpochDomain(const EpochDomain&) =delete;
+    EpochDomain& operator=(const EpochDomain&) =delete;
+    
+    static EpochDomain& global() {
+        static EpochDomain domain;
+        return domain;
+    }
+    
+    // Read sections may be nested, only the outermost one announces the epoch
+    void enter() {
+        ThreadSlot& slot = threadSlot();
+        if(slot.nesting++ == 0) {
+            slot.slot->epoch.store(epoch_.load());
+        }
+    }
+    // Returns true if the outermost read section was left
+    bool leave() {
+        ThreadSlot& slot = threadSlot();
+        if(--slot.nesting != 0) return false;
+        slot.slot->epoch.store(0, std::memory_order_release);
+        return true;
+    }
+    
+    // Called after a version was unlinked, returns the epoch which all readers have to reach before it is deleted
+    uint64_t advance() {
+        return epoch_.fetch_add(1) + 1;
+    }
+    
+    bool isQuiescent(uint64_t retireEpoch) const {
+        auto announcedBefore = [retireEpoch](const Slot& slot) {
+            const uint64_t epoch = slot.epoch.load();
+            return epoch != 0 && epoch < retireEpoch;
+        };
+        for(const Slot& slot: slots_) {
+            if(announcedBefore(slot)) return false;
+        }
+        for(const Slot* slot = overflow_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            if(announcedBefore(*slot)) return false;
+        }
+        return true;
+    }
+};
+
+class EpochGuard {
+public:
+    EpochGuard() { EpochDomain::global().enter(); }
+    ~EpochGuard() { EpochDomain::global().leave(); }
+    EpochGuard(const EpochGuard&) =delete;
+    EpochGuard& operator=(const EpochGuard&) =delete;
+};
+
+
+template<typename VariantType = GenericValueHolder>
+class SnapshotMap: public CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, SnapshotMap<VariantType>>, public ViewableMapValue {
+public:
+    using Version = Map<VariantType>;
+    
+private:
+    std::atomic<const Version*> current_;
+    mutable std::atomic<bool> pending_{false}; // Retired versions are left
+    // Writers are serialized, readers only try to take this lock for reclaiming
+    mutable std::mutex writeMutex_;
+    mutable std::vector<std::pair<uint64_t, std::unique_ptr<const Version>>> retired_;
+    
+    // Reclaims after leaving the outermost read section, so that the own announced epoch does not hold back versions
+    class ReadSection {
+    public:
+        explicit ReadSection(const SnapshotMap& map): map_(map) { EpochDomain::global().enter(); }
+        ~ReadSection() {
+            if(EpochDomain::global().leave()) map_.tryReclaim();
+        }
+        ReadSection(const ReadSection&) =delete;
+        ReadSection& operator=(const ReadSection&) =delete;
+        
+    private:
+        const SnapshotMap& map_;
+    };
+    
+public:
+    explicit SnapshotMap(std::unique_ptr<const Version> initial): current_(initial.release()) {}
+    SnapshotMap(Version initial): SnapshotMap(std::make_unique<const Version>(std::move(initial))) {}
+    SnapshotMap(const SnapshotMap&) =delete;
+    SnapshotMap& operator=(const SnapshotMap&) =delete;
+    
+    // No reader may be active anymore
+    virtual ~SnapshotMap() {
+        delete current_.load();
+    }
+    
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, SnapshotMap<VariantType>>::visit;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, SnapshotMap<VariantType>>::iterate;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, SnapshotMap<VariantType>>::size;
+    
+    // Size of the current version, a following visit or iterate may see a newer one. Use read for consistent access.
+    virtual size_t size() const override {
+        ReadSection section(*this);
+        return current_.load()->size();
+    }
+    
+    virtual FlatView<MapIndexType> flat() const override { return FlatView<MapIndexType>(*this); }
+    
+    virtual void visit(std::string_view k, ValueViewer<MapIndexType>& visitor) const override {
+        visit(k, visitor, ValueViewer<MapIndexType>::TypeList{});
+    }
+    template<typename TViewer>
+    void visit(const char* k, TViewer& visitor) const {
+        visit(std::string_view(k), visitor, typename TViewer::TypeList{});
+    }
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(std::string_view k, TViewer& visitor, TLIST = TLIST{}) const {
+        ReadSection section(*this);
+        current_.load()->visit(k, visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        ReadSection section(*this);
+        current_.load()->iterate(visitor, TLIST{});
+    }
+    
+    // Calls func with the current version, which stays valid until func returns
+    template<typename Func>
+    decltype(auto) read(Func&& func) const {
+        ReadSection section(*this);
+        return func(*current_.load());
+    }
+    
+    // Replaces the current version, readers still visiting the previous one are not blocked
+    void publish(std::unique_ptr<const Version> next) {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        std::unique_ptr<const Version> previous(current_.exchange(next.release()));
+        retired_.emplace_back(EpochDomain::global().advance(), std::move(previous));
+        reclaim();
+    }
+    void publish(Version next) {
+        publish(std::make_unique<const Version>(std::move(next)));
+    }
+    
+    // Number of replaced versions not yet deleted
+    size_t retired() {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        reclaim();
+        return retired_.size();
+    }
+    
+private:
+    // Requires writeMutex_
+    void reclaim() const {
+        auto& domain = EpochDomain::global();
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&domain](const auto& r) {
+            return domain.isQuiescent(r.first);
+        }), retired_.end());
+        pending_.store(!retired_.empty(), std::memory_order_relaxed);
+    }
+    
+    void tryReclaim() const {
+        if(!pending_.load(std::memory_order_relaxed)) return;
+        std::unique_lock<std::mutex> lock(writeMutex_, std::try_to_lock);
+        if(lock.owns_lock()) reclaim();
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// Cursors: pull based iteration
+//
+// A cursor is a position in a List, ColumnList or Map (insertion order), which is advanced by the caller. 
+// The value at the position is passed to a viewer as by iterate. Positions can be stored (e.g. for pagination), 
+// two cursors can be advanced alternately (merge join) and other work can be done between two steps.
+// ----------------------------------------------------------------------------
+
+template<typename Container>
+class Cursor {
+public:
+    using IndexType = conditional_t<std::is_base_of_v<ViewableMapValue, Container>, MapIndexType, ListIndexType>;
+    
+private:
+    const Container* container_;
+    size_t position_;
+    
+public:
+    explicit Cursor(const Container& container, size_t position = 0): container_(&container), position_(position) {}
+    
+    bool done() const { return position_ >= container_->size(); }
+    size_t position() const { return position_; }
+    void seek(size_t position) { position_ = position; }
+    Cursor& operator++() { ++position_; return *this; }
+    
+    // Passes the current value to visitor.handle(index, v) and returns its result, false if the cursor is done
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    bool visit(TViewer& visitor, TLIST = TLIST{}) const {
+        if(done()) return false;
+        return container_->iterateRange(position_, position_ + 1, visitor, TLIST{});
+    }
+    
+    // Passes the current value to func(index, v) like visit, func has to accept all types of FlatValueViewer
+    template<typename Func>
+    bool get(Func&& func) const {
+        auto viewer = freeVisitor<FlatValueViewer<IndexType>>(std::forward<Func>(func));
+        return visit(viewer);
+    }
+};
+
+template<typename Container>
+Cursor<Container> cursor(const Container& container, size_t position = 0) {
+    return Cursor<Container>(container, position);
+}
+
+
+#if defined(__cpp_impl_coroutine) && defined(__cpp_lib_coroutine)
+// Minimal generator, yielded values are referenced until the coroutine is resumed
+template<typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T* current = nullptr;
+        
+        Generator get_return_object() { return Generator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const T& v) noexcept {
+            current = std::addressof(v);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    
+    class iterator {
+    private:
+        std::coroutine_handle<promise_type> handle_;
+        
+    public:
+        explicit iterator(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+        const T& operator*() const { return *handle_.promise().current; }
+        iterator& operator++() {
+            handle_.resume();
+            return *this;
+        }
+        bool operator==(std::default_sentinel_t) const { return handle_.done(); }
+    };
+    
+private:
+    std::coroutine_handle<promise_type> handle_;
+    
+    explicit Generator(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+    
+public:
+    Generator(Generator&& other) noexcept: handle_(std::exchange(other.handle_, nullptr)) {}
+    Generator(const Generator&) =delete;
+    Generator& operator=(const Generator&) =delete;
+    ~Generator() {
+        if(handle_) handle_.destroy();
+    }
+    
+    iterator begin() {
+        handle_.resume();
+        return iterator(handle_);
+    }
+    std::default_sentinel_t end() { return {}; }
+};
+
+// Yields (index, value) of all elements, starting at first
+template<typename VariantType>
+Generator<std::pair<ListIndexType, const VariantType&>> elements(const List<VariantType>& list, ListIndexType first = 0) {
+    for(ListIndexType i = first; i < (ListIndexType) list.size(); ++i) {
+        co_yield {i, list.at(i)};
+    }
+}
+
+// Yields (key, value) of all entries in insertion order
+template<typename VariantType>
+Generator<std::pair<MapIndexType, const VariantType&>> entries(const Map<VariantType>& map) {
+    for(size_t i = 0; i < map.size(); ++i) {
+        const auto& entry = map.entryAt(i);
+        co_yield {entry.first, entry.second};
+    }
+}
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Streaming JSON reader
+//
+// JsonReader is a SAX style parser, which passes the values of the input to a handler without building 
+// a tree. Strings are passed as std::string_view into the input, only strings with escapes are decoded 
+// into a buffer of the reader. All string_views are valid as long as the reader exists.
+// The input has to be strict RFC 8259 JSON: numbers follow its grammar (no leading zeros, digits on both 
+// sides of the point), strings contain no raw control characters and surrogate escapes come in valid pairs.
+// TreeBuilder is a handler which builds Map/List trees: containers are created when they are complete, 
+// hence with their final size, and arrays of numbers become std::vector<long>/std::vector<double>.
+// Objects with duplicate keys are rejected by TreeBuilder, the reader itself passes all keys.
+// ----------------------------------------------------------------------------
+
+// Handler interface of JsonReader, each call returns false to abort parsing
+//   bool null();
+//   bool boolean(bool);
+//   bool integer(long);
+//   bool real(double);
+//   bool string(std::string_view);
+//   bool startObject();
+//   bool key(std::string_view);
+//   bool endObject();
+//   bool startArray();
+//   bool endArray();
+class JsonReader {
+public:
+    static const size_t maxDepth = 512;
+    
+private:
+    std::string_view in_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;
+    std::string error_;
+    std::deque<std::string> decoded_; // Strings with escapes, deque keeps them in place
+    
+public:
+    explicit JsonReader(std::string_view input): in_(input) {}
+    JsonReader(const JsonReader&) =delete;
+    JsonReader& operator=(const JsonReader&) =delete;
+    
+    // Parses exactly one value, returns false on a syntax error or if the handler aborted
+    template<typename Handler>
+    bool parse(Handler& handler) {
+        pos_ = 0;
+        depth_ = 0;
+        error_.clear();
+        skipWhitespace();
+        if(!parseValue(handler)) return false;
+        skipWhitespace();
+        if(pos_ != in_.size()) return fail("unexpected characters after the value");
+        return true;
+    }
+    
+    const std::string& error() const { return error_; }
+    size_t errorOffset() const { return pos_; }
+    
+private:
+    bool fail(const char* message) {
+        if(error_.empty()) error_ = message;
+        return false;
+    }
+    
+    void skipWhitespace() {
+        while(pos_ < in_.size() && (in_[pos_] == ' ' || in_[pos_] == '\n' || in_[pos_] == '\r' || in_[pos_] == '\t')) ++pos_;
+    }
+    
+    bool consume(char c) {
+        skipWhitespace();
+        if(pos_ < in_.size() && in_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+    
+    bool literal(std::string_view word) {
+        if(in_.substr(pos_, word.size()) != word) return fail("invalid literal");
+        pos_ += word.size();
+        return true;
+    }
+    
+    template<typename Handler>
+    bool parseValue(Handler& handler) {
+        if(pos_ >= in_.size()) return fail("unexpected end of input");
+        switch(in_[pos_]) {
+            case '{': return parseObject(handler);
+            case '[': return parseArray(handler);
+            case '"': {
+                std::string_view s;
+                return parseString(s) && (handler.string(s) || fail("aborted by handler"));
+            }
+            case 't': return literal("true") && (handler.boolean(true) || fail("aborted by handler"));
+            case 'f': return literal("false") && (handler.boolean(false) || fail("aborted by handler"));
+            case 'n': return literal("null") && (handler.null() || fail("aborted by handler"));
+            default: return parseNumber(handler);
+        }
+    }
+    
+    template<typename Handler>
+    bool parseObject(Handler& handler) {
+        if(++depth_ > maxDepth) return fail("nesting too deep");
+        ++pos_;
+        if(!handler.startObject()) return fail("aborted by handler");
+        if(!consume('}')) {
+            do {
+                skipWhitespace();
+                std::string_view k;
+                if(pos_ >= in_.size() || in_[pos_] != '"') return fail("expected key");
+                if(!parseString(k)) return false;
+                if(!consume(':')) return fail("expected ':'");
+                if(!handler.key(k)) return fail("aborted by handler");
+                skipWhitespace();
+                if(!parseValue(handler)) return false;
+            } while(consume(','));
+            if(!consume('}')) return fail("expected ',' or '}'");
+        }
+        --depth_;
+        return handler.endObject() || fail("aborted by handler");
+    }
+    
+    template<typename Handler>
+    bool parseArray(Handler& handler) {
+        if(++depth_ > maxDepth) return fail("nesting too deep");
+        ++pos_;
+        if(!handler.startArray()) return fail("aborted by handler");
+        if(!consume(']')) {
+            do {
+                skipWhitespace();
+                if(!parseValue(handler)) return false;
+            } while(consume(','));
+            if(!consume(']')) return fail("expected ',' or ']'");
+        }
+        --depth_;
+        return handler.endArray() || fail("aborted by handler");
+    }
+    
+    // number = [ "-" ] ( "0" / 1-9 *DIGIT ) [ "." 1*DIGIT ] [ ( "e" / "E" ) [ "+" / "-" ] 1*DIGIT ]
+    template<typename Handler>
+    bool parseNumber(Handler& handler) {
+        const size_t start = pos_;
+        bool isReal = false;
+        if(pos_ < in_.size() && in_[pos_] == '-') ++pos_;
+        if(!isDigit(pos_)) return fail(pos_ == start ? "unexpected character" : "invalid number");
+        if(in_[pos_++] != '0') {
+            skipDigits();
+        }
+        else if(isDigit(pos_)) {
+            return fail("invalid number, leading zero");
+        }
+        if(pos_ < in_.size() && in_[pos_] == '.') {
+            isReal = true;
+            if(!isDigit(++pos_)) return fail("invalid number, digit expected after '.'");
+            skipDigits();
+        }
+        if(pos_ < in_.size() && (in_[pos_] == 'e' || in_[pos_] == 'E')) {
+            isReal = true;
+            ++pos_;
+            if(pos_ < in_.size() && (in_[pos_] == '+' || in_[pos_] == '-')) ++pos_;
+            if(!isDigit(pos_)) return fail("invalid number, digit expected in exponent");
+            skipDigits();
+        }
+        const char* first = in_.data() + start;
+        const char* last = in_.data() + pos_;
+        if(!isReal) {
+            long v = 0;
+            auto result = std::from_chars(first, last, v);
+            if(result.ec == std::errc() && result.ptr == last) return handler.integer(v) || fail("aborted by handler");
+            // Integers exceeding long are read as double
+        }
+        double v = 0;
+        auto result = std::from_chars(first, last, v);
+        if(result.ec != std::errc() || result.ptr != last) return fail("invalid number");
+        return handler.real(v) || fail("aborted by handler");
+    }
+    
+    bool isDigit(size_t pos) const {
+        return pos < in_.size() && in_[pos] >= '0' && in_[pos] <= '9';
+    }
+    void skipDigits() {
+        while(isDigit(pos_)) ++pos_;
+    }
+    
+    bool isControl(size_t pos) const {
+        return (unsigned char) in_[pos] < 0x20;
+    }
+    
+    // Reads a string, s refers to the input if there are no escapes
+    bool parseString(std::string_view& s) {
+        const size_t start = ++pos_;
+        while(pos_ < in_.size() && in_[pos_] != '"' && in_[pos_] != '\\' && !isControl(pos_)) ++pos_;
+        if(pos_ >= in_.size()) return fail("unterminated string");
+        if(isControl(pos_)) return fail("control character in string");
+        if(in_[pos_] == '"') {
+            s = in_.substr(start, pos_ - start);
+            ++pos_;
+            return true;
+        }
+        
+        std::string& out = decoded_.emplace_back(in_.substr(start, pos_ - start));
+        while(pos_ < in_.size() && in_[pos_] != '"') {
+            if(in_[pos_] != '\\') {
+                if(isControl(pos_)) return fail("control character in string");
+                out += in_[pos_++];
+                continue;
+            }
+            if(++pos_ >= in_.size()) break;
+            switch(in_[pos_++]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long code = 0;
+                    if(!parseHex4(code)) return false;
+                    // A high surrogate has to be followed by a low one, unpaired surrogates are no characters
+                    if(code >= 0xDC00 && code < 0xE000) return fail("unpaired low surrogate");
+                    if(code >= 0xD800 && code < 0xDC00) {
+                        if(in_.substr(pos_, 2) != "\\u") return fail("unpaired high surrogate");
+                        pos_ += 2;
+                        unsigned long low = 0;
+                        if(!parseHex4(low)) return false;
+                        if(low < 0xDC00 || low >= 0xE000) return fail("invalid low surrogate");
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: return fail("invalid escape");
+            }
+        }
+        if(pos_ >= in_.size()) return fail("unterminated string");
+        ++pos_;
+        s = out;
+        return true;
+    }
+    
+    bool parseHex4(unsigned long& code) {
+        if(pos_ + 4 > in_.size()) return fail("invalid unicode escape");
+        auto result = std::from_chars(in_.data() + pos_, in_.data() + pos_ + 4, code, 16);
+        if(result.ptr != in_.data() + pos_ + 4) return fail("invalid unicode escape");
+        pos_ += 4;
+        return true;
+    }
+    
+    static void appendUtf8(std::string& out, unsigned long code) {
+        if(code < 0x80) {
+            out += (char) code;
+        }
+        else if(code < 0x800) {
+            out += (char) (0xC0 | (code >> 6));
+            out += (char) (0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000) {
+            out += (char) (0xE0 | (code >> 12));
+            out += (char) (0x80 | ((code >> 6) & 0x3F));
+            out += (char) (0x80 | (code & 0x3F));
+        }
+        else {
+            out += (char) (0xF0 | (code >> 18));
+            out += (char) (0x80 | ((code >> 12) & 0x3F));
+            out += (char) (0x80 | ((code >> 6) & 0x3F));
+            out += (char) (0x80 | (code & 0x3F));
+        }
+    }
+};
+
+
+// Builds a tree of Map/List from the events of JsonReader or MsgPackReader.
+// Object members with null are omitted, null in arrays is not representable and aborts parsing.
+// Objects with duplicate keys abort parsing as well, instead of keeping one of the values.
+template<typename VariantType = GenericValueHolder>
+class TreeBuilder {
+private:
+    // Open containers, frames are reused to keep the capacity of their vectors
+    struct Frame {
+        bool isObject = false;
+        std::string_view key;
+        std::vector<std::pair<std::string_view, VariantType>> entries;
+        std::vector<VariantType> elements;
+        size_t integers = 0;
+        size_t reals = 0;
+    };
+    
+    std::vector<Frame> frames_;
+    size_t depth_ = 0;
+    std::optional<VariantType> result_;
+    const char* error_ = nullptr;
+    // Owner of the input, if set arrays in the input are adopted as ExternalArray instead of being copied
+    std::shared_ptr<const void> input_;
+    
+public:
+    TreeBuilder() =default;
+    explicit TreeBuilder(std::shared_ptr<const void> input): input_(std::move(input)) {}
+    
+    std::optional<VariantType>& result() { return result_; }
+    // Reason if the builder aborted parsing, nullptr otherwise
+    const char* error() const { return error_; }
+    
+    bool null() {
+        return (depth_ > 0 && frames_[depth_ - 1].isObject) || reject("null is only supported as object member");
+    }
+    bool boolean(bool v) { return add(VariantType(v)); }
+    bool integer(long v) {
+        if(depth_ > 0) ++frames_[depth_ - 1].integers;
+        return add(VariantType(v));
+    }
+    bool real(double v) {
+        if(depth_ > 0) ++frames_[depth_ - 1].reals;
+        return add(VariantType(v));
+    }
+    // Integers exceeding long, only from MsgPackReader
+    bool integer(size_t v) { return add(VariantType(v)); }
+    // Binary data and typed arrays, only from MsgPackReader
+    bool bytes(ContiguousDataView<unsigned char> v) { return addArray(v); }
     template<typename T>
-    Value(T&& v): val_(std::forward<T>(v)) {}
+    bool array(ContiguousDataView<T> v) { return addArray(v); }
+    template<typename T>
+    bool array(std::vector<T>&& v) {
+        if constexpr (std::is_constructible_v<VariantType, std::vector<T>>) {
+            return add(VariantType(std::move(v)));
+        }
+        else {
+            return false;
+        }
+    }
+    bool string(std::string_view v) { return add(VariantType(std::string(v))); }
+    
+    bool startObject() {
+        open(true);
+        return true;
+    }
+    bool key(std::string_view k) {
+        frames_[depth_ - 1].key = k;
+        return true;
+    }
+    bool endObject() {
+        Frame& frame = frames_[--depth_];
+        auto map = std::make_shared<Map<VariantType>>(std::make_move_iterator(frame.entries.begin()), std::make_move_iterator(frame.entries.end()));
+        // The map keeps the first of equal keys
+        if(map->size() != frame.entries.size()) return reject("duplicate key");
+        return add(VariantType(std::shared_ptr<ViewableMapValue>(std::move(map))));
+    }
+    
+    bool startArray() {
+        open(false);
+        return true;
+    }
+    bool endArray() {
+        Frame& frame = frames_[--depth_];
+        const size_t size = frame.elements.size();
+        // Arrays of numbers are stored contiguous
+        if(size > 0 && frame.integers == size) {
+            std::vector<long> values;
+            values.reserve(size);
+            for(const auto& v: frame.elements) values.push_back(*variant_access<VariantType>::template getIf<long>(v));
+            return add(VariantType(std::move(values)));
+        }
+        if(size > 0 && frame.integers + frame.reals == size) {
+            std::vector<double> values;
+            values.reserve(size);
+            for(const auto& v: frame.elements) {
+                const double* d = variant_access<VariantType>::template getIf<double>(v);
+                values.push_back(d != nullptr ? *d : (double) *variant_access<VariantType>::template getIf<long>(v));
+            }
+            return add(VariantType(std::move(values)));
+        }
+        auto list = std::make_shared<List<VariantType>>(std::make_move_iterator(frame.elements.begin()), std::make_move_iterator(frame.elements.end()));
+        return add(VariantType(std::shared_ptr<ViewableListValue>(std::move(list))));
+    }
+    
+private:
+    void open(bool isObject) {
+        if(depth_ == frames_.size()) frames_.emplace_back();
+        Frame& frame = frames_[depth_++];
+        frame.isObject = isObject;
+        frame.entries.clear();
+        frame.elements.clear();
+        frame.integers = 0;
+        frame.reals = 0;
+    }
+    
+    bool reject(const char* reason) {
+        error_ = reason;
+        return false;
+    }
+    
+    template<typename T>
+    bool addArray(ContiguousDataView<T> v) {
+        if constexpr (std::is_constructible_v<VariantType, ExternalArray<T>>) {
+            if(input_ != nullptr) return add(VariantType(ExternalArray<T>(std::shared_ptr<const T>(input_, v.data), v.size)));
+        }
+        if constexpr (std::is_constructible_v<VariantType, std::vector<T>>) {
+            return add(VariantType(std::vector<T>(v.data, v.data + v.size)));
+        }
+        else {
+            return false;
+        }
+    }
+    
+    bool add(VariantType&& v) {
+        if(depth_ == 0) {
+            result_.emplace(std::move(v));
+            return true;
+        }
+        Frame& parent = frames_[depth_ - 1];
+        if(parent.isObject) {
+            parent.entries.emplace_back(parent.key, std::move(v));
+        }
+        else {
+            parent.elements.push_back(std::move(v));
+        }
+        return true;
+    }
+};
+
+// Parses a JSON document into result, returns false and sets error (if not null) on failure
+template<typename VariantType = GenericValueHolder>
+bool readJson(std::string_view input, std::optional<VariantType>& result, std::string* error = nullptr) {
+    JsonReader reader(input);
+    TreeBuilder<VariantType> builder;
+    if(!reader.parse(builder)) {
+        if(error != nullptr) *error = (builder.error() != nullptr ? std::string(builder.error()) : reader.error()) + " at offset " + std::to_string(reader.errorOffset());
+        return false;
+    }
+    result = std::move(builder.result());
+    return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// Buffered JSON and text writer
+//
+// ValueWriter serializes values into an OutputBuffer with one viewer instance for all depths.
+// Numbers are formatted with std::to_chars, strings are copied in runs of characters without escapes, 
+// binary data is encoded as base64 (JSON) or hex (text) in one pass.
+// The text format is the indented key/value form used for diagnostics.
+// ----------------------------------------------------------------------------
+
+// Growing buffer, which is written to a file each time it exceeds the flush threshold
+class OutputBuffer {
+public:
+    static const size_t defaultFlushThreshold = 64 * 1024;
+    
+private:
+    std::string data_;
+    std::FILE* file_ = nullptr;
+    size_t flushThreshold_ = 0;
+    
+public:
+    OutputBuffer() =default;
+    explicit OutputBuffer(std::FILE* file, size_t flushThreshold = defaultFlushThreshold): file_(file), flushThreshold_(flushThreshold) {
+        data_.reserve(flushThreshold + flushThreshold / 8);
+    }
+    OutputBuffer(const OutputBuffer&) =delete;
+    OutputBuffer& operator=(const OutputBuffer&) =delete;
+    ~OutputBuffer() { flush(); }
+    
+    void append(char c) {
+        data_.push_back(c);
+    }
+    void append(std::string_view s) {
+        data_.append(s.data(), s.size());
+    }
+    // Grows the buffer by n characters and returns the position to write them to
+    char* extend(size_t n) {
+        const size_t size = data_.size();
+        data_.resize(size + n);
+        return &data_[size];
+    }
+    void shrink(size_t n) {
+        data_.resize(data_.size() - n);
+    }
+    
+    template<typename T>
+    void appendNumber(T v) {
+        char* first = extend(32);
+        auto result = std::to_chars(first, first + 32, v);
+        shrink(32 - (result.ptr - first));
+    }
+    
+    // Writes the buffer if a file is set and the threshold is exceeded
+    void flushIfFull() {
+        if(file_ != nullptr && data_.size() >= flushThreshold_) flush();
+    }
+    void flush() {
+        if(file_ == nullptr || data_.empty()) return;
+        std::fwrite(data_.data(), 1, data_.size(), file_);
+        std::fflush(file_);
+        data_.clear();
+    }
+    
+    // Content not written yet, all content if there is no file
+    const std::string& str() const { return data_; }
+    void clear() { data_.clear(); }
+};
+
+enum class WriteFormat { Json, Text };
+
+template<template<typename IndexType> class TViewer = ValueViewer>
+class ValueWriter {
+private:
+    struct MapEntries {
+        ValueWriter* self;
+        
+        template<typename T>
+        bool operator()(MapIndexType k, const T& v) const {
+            self->writeMapEntry(k, v);
+            return true;
+        }
+    };
+    struct ListElements {
+        ValueWriter* self;
+        
+        template<typename T>
+        bool operator()(ListIndexType i, const T& v) const {
+            self->writeListElement(i, v);
+            return true;
+        }
+    };
+    
+    OutputBuffer& out_;
+    const WriteFormat format_;
+    size_t depth_ = 0;
+    bool first_ = true;
+    FreeVisitor<TViewer<MapIndexType>, MapEntries> mapViewer_;
+    FreeVisitor<TViewer<ListIndexType>, ListElements> listViewer_;
+    
+public:
+    explicit ValueWriter(OutputBuffer& out, WriteFormat format = WriteFormat::Json): out_(out), format_(format), mapViewer_(MapEntries{this}), listViewer_(ListElements{this}) {}
+    // Both viewers refer to this instance
+    ValueWriter(const ValueWriter&) =delete;
+    ValueWriter& operator=(const ValueWriter&) =delete;
+    
+    // Writes containers, scalars and ContiguousDataViews. Text output ends with a new line.
+    template<typename T>
+    void write(const T& v) {
+        writeValue(v);
+        if(format_ == WriteFormat::Text) out_.append('\n');
+        out_.flushIfFull();
+    }
+    
+private:
+    template<typename T>
+    void writeMapEntry(MapIndexType k, const T& v) {
+        if(format_ == WriteFormat::Json) {
+            if(!first_) out_.append(',');
+            writeString(k);
+            out_.append(':');
+        }
+        else {
+            indent();
+            out_.append(k);
+            out_.append(": ");
+        }
+        first_ = false;
+        writeValue(v);
+        if(format_ == WriteFormat::Text) out_.append('\n');
+        out_.flushIfFull();
+    }
+    
+    template<typename T>
+    void writeListElement(ListIndexType i, const T& v) {
+        if(format_ == WriteFormat::Json) {
+            if(!first_) out_.append(',');
+        }
+        else {
+            indent();
+            out_.append('#');
+            out_.appendNumber(i);
+            out_.append(": ");
+        }
+        first_ = false;
+        writeValue(v);
+        if(format_ == WriteFormat::Text) out_.append('\n');
+        out_.flushIfFull();
+    }
+    
+    template<typename T>
+    void writeValue(const T& v) {
+        if constexpr (std::is_base_of_v<ViewableMapValue, T>) {
+            writeContainer(v, '{', '}', static_cast<TViewer<MapIndexType>&>(mapViewer_));
+        }
+        else if constexpr (std::is_base_of_v<ViewableListValue, T>) {
+            writeContainer(v, '[', ']', static_cast<TViewer<ListIndexType>&>(listViewer_));
+        }
+        else if constexpr (std::is_same_v<T, bool>) {
+            out_.append(v ? "true" : "false");
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            writeFloating(v);
+        }
+        else if constexpr (std::is_arithmetic_v<T>) {
+            out_.appendNumber(v);
+        }
+        else if constexpr (std::is_same_v<T, const char*>) {
+            writeString(v == nullptr ? std::string_view() : std::string_view(v));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            writeString(v);
+        }
+        else if constexpr (std::is_same_v<T, ContiguousDataView<unsigned char>>) {
+            writeBinary(v.data, v.size);
+        }
+        else {
+            // ContiguousDataView of numbers
+            out_.append('[');
+            for(size_t i = 0; i < v.size; ++i) {
+                if(i > 0) out_.append(format_ == WriteFormat::Json ? "," : ", ");
+                writeValue(v.data[i]);
+            }
+            out_.append(']');
+        }
+    }
+    
+    template<typename Container, typename Viewer>
+    void writeContainer(const Container& v, char open, char close, Viewer& viewer) {
+        out_.append(open);
+        if(format_ == WriteFormat::Text) out_.append('\n');
+        const bool outerFirst = first_;
+        first_ = true;
+        ++depth_;
+        v.iterate(viewer);
+        --depth_;
+        first_ = outerFirst;
+        if(format_ == WriteFormat::Text) indent();
+        out_.append(close);
+    }
+    
+    template<typename T>
+    void writeFloating(T v) {
+        // JSON has no representation of inf and nan
+        if(format_ == WriteFormat::Json && !(v - v == 0)) {
+            out_.append("null");
+            return;
+        }
+        out_.appendNumber(v);
+    }
+    
+    void writeString(std::string_view s) {
+        if(format_ == WriteFormat::Text) {
+            out_.append(s);
+            return;
+        }
+        static const char hexDigits[] = "0123456789abcdef";
+        out_.append('"');
+        size_t run = 0;
+        for(size_t i = 0; i < s.size(); ++i) {
+            const unsigned char c = s[i];
+            if(c >= 0x20 && c != '"' && c != '\\') continue;
+            out_.append(s.substr(run, i - run));
+            run = i + 1;
+            switch(c) {
+                case '"': out_.append("\\\""); break;
+                case '\\': out_.append("\\\\"); break;
+                case '\n': out_.append("\\n"); break;
+                case '\r': out_.append("\\r"); break;
+                case '\t': out_.append("\\t"); break;
+                default: {
+                    char* escape = out_.extend(6);
+                    std::memcpy(escape, "\\u00", 4);
+                    escape[4] = hexDigits[c >> 4];
+                    escape[5] = hexDigits[c & 0xF];
+                }
+            }
+        }
+        out_.append(s.substr(run));
+        out_.append('"');
+    }
+    
+    void writeBinary(const unsigned char* data, size_t size) {
+        if(format_ == WriteFormat::Text) {
+            static const char hexDigits[] = "0123456789abcdef";
+            char* hex = out_.extend(2 * size);
+            for(size_t i = 0; i < size; ++i) {
+                hex[2 * i] = hexDigits[data[i] >> 4];
+                hex[2 * i + 1] = hexDigits[data[i] & 0xF];
+            }
+            return;
+        }
+        static const char base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        out_.append('"');
+        char* encoded = out_.extend((size + 2) / 3 * 4);
+        size_t i = 0;
+        for(; i + 3 <= size; i += 3) {
+            const uint32_t bits = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+            encoded[0] = base64Digits[bits >> 18];
+            encoded[1] = base64Digits[(bits >> 12) & 0x3F];
+            encoded[2] = base64Digits[(bits >> 6) & 0x3F];
+            encoded[3] = base64Digits[bits & 0x3F];
+            encoded += 4;
+        }
+        if(i < size) {
+            const uint32_t bits = (uint32_t(data[i]) << 16) | (i + 1 < size ? uint32_t(data[i + 1]) << 8 : 0);
+            encoded[0] = base64Digits[bits >> 18];
+            encoded[1] = base64Digits[(bits >> 12) & 0x3F];
+            encoded[2] = i + 1 < size ? base64Digits[(bits >> 6) & 0x3F] : '=';
+            encoded[3] = '=';
+        }
+        out_.append('"');
+    }
+    
+    void indent() {
+        std::memset(out_.extend(2 * depth_), ' ', 2 * depth_);
+    }
+};
+
+// Serializes a value as compact JSON
+template<template<typename IndexType> class TViewer = ValueViewer, typename T>
+std::string writeJson(const T& v) {
+    OutputBuffer out;
+    ValueWriter<TViewer>(out, WriteFormat::Json).write(v);
+    return out.str();
+}
+
+// Serializes a value in the indented text format
+template<template<typename IndexType> class TViewer = ValueViewer, typename T>
+std::string writeText(const T& v) {
+    OutputBuffer out;
+    ValueWriter<TViewer>(out, WriteFormat::Text).write(v);
+    return out.str();
+}
+
+
+// ----------------------------------------------------------------------------
+// Memory mappable binary documents
+//
+// encodeBinary writes a Map/List tree into a flat byte format which is read in place: containers refer 
+// to their children by offset, maps have an index of entries sorted by key, strings are NUL terminated 
+// and arrays are 8 byte aligned. BinaryMapValue/BinaryListValue are views into these bytes. Strings and 
+// arrays are passed to viewers as pointers into the bytes (const char*, ContiguousDataView). Only map keys 
+// are copied, as viewers get them as std::string.
+// Views are objects with many vptrs, constructing them per visit would cost more than the visit itself. 
+// Containers are therefore numbered in pre-order and BinaryDocument creates all views once when loading.
+// The byte order is native, documents are only portable between machines with the same endianness.
+// Integer scalars are stored with 64 bits. Arrays are passed in place, hence they keep the width of their 
+// element type, which is recorded in the header; documents are rejected where long or size_t differ.
+// Strings, arrays and containers are limited to 2^32 - 1 elements, encoding larger ones fails.
+//
+// Layout, all offsets are relative to the beginning of the document:
+//   BinaryHeader   magic, version, size of the document, number of maps and lists, slot of the root container, 
+//                  sizes of long, size_t and int in bytes
+//   map node       uint64 count, uint64 offset of the index, BinaryMapEntry[count]
+//   map index      uint32[count], positions of the entries sorted by key
+//   list node      uint64 count, BinarySlot[count]
+// ----------------------------------------------------------------------------
+
+enum class BinaryType: uint32_t {
+    Long, Size, Int, Bool, Double, Float, String,
+    LongArray, SizeArray, IntArray, BoolArray, DoubleArray, FloatArray, Bytes,
+    List, Map
+};
+
+// Scalars are stored in payload, strings and arrays of size elements at offset payload.
+// Containers are stored at offset payload, size is their number in pre-order.
+struct BinarySlot {
+    BinaryType type;
+    uint32_t size;
+    uint64_t payload;
+};
+
+struct BinaryKey {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct BinaryMapEntry {
+    BinaryKey key;
+    BinarySlot value;
+};
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t size;
+    uint64_t maps;
+    uint64_t lists;
+    BinarySlot root;
+    uint8_t longSize;
+    uint8_t sizeSize;
+    uint8_t intSize;
+    uint8_t reserved[5];
+};
+
+static const uint32_t binaryVersion = 2;
+
+// Storage of scalars in BinarySlot::payload, integers are widened to 64 bits
+template<typename T>
+using binary_scalar_t = conditional_t<std::is_same_v<T, bool> || std::is_floating_point_v<T>, T, conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+template<typename T>
+constexpr BinaryType binaryScalarType() {
+    if constexpr (std::is_same_v<T, long>) return BinaryType::Long;
+    else if constexpr (std::is_same_v<T, size_t>) return BinaryType::Size;
+    else if constexpr (std::is_same_v<T, int>) return BinaryType::Int;
+    else if constexpr (std::is_same_v<T, bool>) return BinaryType::Bool;
+    else if constexpr (std::is_same_v<T, double>) return BinaryType::Double;
+    else return BinaryType::Float;
+}
+
+template<typename T>
+constexpr BinaryType binaryArrayType() {
+    if constexpr (std::is_same_v<T, long>) return BinaryType::LongArray;
+    else if constexpr (std::is_same_v<T, size_t>) return BinaryType::SizeArray;
+    else if constexpr (std::is_same_v<T, int>) return BinaryType::IntArray;
+    else if constexpr (std::is_same_v<T, bool>) return BinaryType::BoolArray;
+    else if constexpr (std::is_same_v<T, double>) return BinaryType::DoubleArray;
+    else if constexpr (std::is_same_v<T, float>) return BinaryType::FloatArray;
+    else return BinaryType::Bytes;
+}
+
+class BinaryDocument;
+
+template<typename TLIST, typename Func>
+bool dispatchBinarySlot(const BinaryDocument& document, const BinarySlot& slot, Func& func);
+
+class BinaryMapValue: public CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, BinaryMapValue>, public ViewableMapValue {
+private:
+    const BinaryDocument* document_;
+    const unsigned char* base_;
+    uint64_t node_;
+    
+public:
+    BinaryMapValue(const BinaryDocument* document, const unsigned char* base, uint64_t node): document_(document), base_(base), node_(node) {}
+    
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, BinaryMapValue>::visit;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, BinaryMapValue>::iterate;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, BinaryMapValue>::size;
     
-    using CRTPVisitable<ViewableValue, Value<VariantType>>::visit;
+    virtual size_t size() const override {
+        return header()[0];
+    }
+    
+    virtual FlatView<MapIndexType> flat() const override { return FlatView<MapIndexType>(*this); }
     
+    // Binary search in the sorted index
+    virtual void visit(std::string_view k, ValueViewer<MapIndexType>& visitor) const override {
+        visit(k, visitor, ValueViewer<MapIndexType>::TypeList{});
+    }
+    template<typename TViewer>
+    void visit(const char* k, TViewer& visitor) const {
+        visit(std::string_view(k), visitor, typename TViewer::TypeList{});
+    }
     template<typename TViewer, typename TLIST = typename TViewer::TypeList>
-    void visit(TViewer& visitor, TLIST = TLIST{}) const {
-        std::visit([&visitor](const auto& v){
-            callFirstOfType(v,
-                // Check if v is a scalar value
-                intersect_type_list_t<TLIST, ScalarValueViewer<void>::TypeList>{}, [&visitor](const auto& scalar){
-                    visitor.handle(scalar);
-                },
-                // if not, check if is v contiguous array
-                predicate_template<test_for_contiguous_data>{}, intersect_type_list_t<TLIST, ContiguousValueViewer<void>::TypeList>{}, [&visitor](const auto& vector){
-                    using VT = decay_t<decltype(vector[0])>;
-                    visitor.handle(ContiguousDataView<VT>{vector.data(), vector.size()});
-                },
-                // if not, check if is v is one of the container classes wrapped in a smart pointer.
-                predicate_template<test_for_smartpointer>{}, intersect_type_list_t<TLIST, ContainerValueViewer<void>::TypeList>{}, [&visitor](const auto& upointer){
-                    visitor.handle(*upointer.get());
+    void visit(std::string_view k, TViewer& visitor, TLIST = TLIST{}) const {
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(base_ + header()[1]);
+        const uint32_t* found = std::lower_bound(index, index + size(), k, [this](uint32_t i, std::string_view key) {
+            return keyAt(i) < key;
+        });
+        if(found == index + size() || keyAt(*found) != k) return;
+        const std::string key(k);
+        handleEntry(key, entries()[*found].value, visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, size(), visitor, TLIST{});
+    }
+    
+    // Iterates the entries [first, last) in insertion order, the bounds are clamped to size(). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(size_t first, size_t last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, size());
+        first = std::min(first, last);
+        std::string key;
+        for(size_t i = first; i < last; ++i) {
+            key.assign(keyAt(i));
+            if(!handleEntry(key, entries()[i].value, visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    const uint64_t* header() const {
+        return reinterpret_cast<const uint64_t*>(base_ + node_);
+    }
+    const BinaryMapEntry* entries() const {
+        return reinterpret_cast<const BinaryMapEntry*>(base_ + node_ + 2 * sizeof(uint64_t));
+    }
+    std::string_view keyAt(size_t i) const {
+        const BinaryKey& key = entries()[i].key;
+        return std::string_view(reinterpret_cast<const char*>(base_ + key.offset), key.size);
+    }
+    
+    template<typename TViewer, typename TLIST>
+    bool handleEntry(MapIndexType k, const BinarySlot& slot, TViewer& visitor, TLIST) const {
+        auto handle = [&k, &visitor](const auto& v){
+            return visitor.handle(k, v);
+        };
+        return dispatchBinarySlot<TLIST>(*document_, slot, handle);
+    }
+};
+
+class BinaryListValue: public CRTPVisitable<ViewableList<ValueViewer<ListIndexType>>, BinaryListValue>, public ViewableListValue {
+private:
+    const BinaryDocument* document_;
+    const unsigned char* base_;
+    uint64_t node_;
+    
+public:
+    BinaryListValue(const BinaryDocument* document, const unsigned char* base, uint64_t node): document_(document), base_(base), node_(node) {}
+    
+    using ViewableListValue::visit;
+    using ViewableListValue::iterate;
+    using ViewableListValue::size;
+    
+    virtual size_t size() const override {
+        return *reinterpret_cast<const uint64_t*>(base_ + node_);
+    }
+    
+    virtual FlatView<ListIndexType> flat() const override { return FlatView<ListIndexType>(*this); }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(ListIndexType i, TViewer& visitor, TLIST = TLIST{}) const {
+        if(i < 0 || (size_t) i >= size()) return;
+        handleElement(i, elements()[i], visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, size(), visitor, TLIST{});
+    }
+    
+    // Iterates the elements [first, last), the bounds are clamped to [0, size()). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(ListIndexType first, ListIndexType last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, (ListIndexType) size());
+        first = std::max<ListIndexType>(first, 0);
+        for(long i = first; i < last; ++i) {
+            if(!handleElement(i, elements()[i], visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    const BinarySlot* elements() const {
+        return reinterpret_cast<const BinarySlot*>(base_ + node_ + sizeof(uint64_t));
+    }
+    
+    template<typename TViewer, typename TLIST>
+    bool handleElement(ListIndexType i, const BinarySlot& slot, TViewer& visitor, TLIST) const {
+        auto handle = [&i, &visitor](const auto& v){
+            return visitor.handle(i, v);
+        };
+        return dispatchBinarySlot<TLIST>(*document_, slot, handle);
+    }
+};
+
+// Writes the binary format, one viewer instance for all depths
+class BinaryEncoder {
+private:
+    struct MapEntries {
+        BinaryEncoder* self;
+        
+        template<typename T>
+        bool operator()(MapIndexType k, const T& v) const {
+            self->addEntry(&k, v);
+            return true;
+        }
+    };
+    struct ListElements {
+        BinaryEncoder* self;
+        
+        template<typename T>
+        bool operator()(ListIndexType, const T& v) const {
+            self->addEntry(nullptr, v);
+            return true;
+        }
+    };
+    
+    // Container being written
+    struct Node {
+        uint64_t offset = 0;
+        uint64_t capacity = 0;
+        uint64_t count = 0;
+    };
+    
+    std::string out_;
+    Node node_;
+    uint64_t maps_ = 0;
+    uint64_t lists_ = 0;
+    bool tooLarge_ = false;
+    FreeVisitor<ValueViewer<MapIndexType>, MapEntries> mapViewer_;
+    FreeVisitor<ValueViewer<ListIndexType>, ListElements> listViewer_;
+    
+public:
+    BinaryEncoder(): mapViewer_(MapEntries{this}), listViewer_(ListElements{this}) {}
+    // Both viewers refer to this instance
+    BinaryEncoder(const BinaryEncoder&) =delete;
+    BinaryEncoder& operator=(const BinaryEncoder&) =delete;
+    
+    // Returns an empty string if a string, array or container exceeds the 32 bit sizes of the format
+    template<typename Container>
+    std::string encode(const Container& root) {
+        out_.clear();
+        maps_ = 0;
+        lists_ = 0;
+        tooLarge_ = false;
+        extend(sizeof(BinaryHeader));
+        const BinarySlot rootSlot = encodeValue(root);
+        if(tooLarge_) return std::string();
+        BinaryHeader header{{'C', 'V', 'P', 'B'}, binaryVersion, out_.size(), maps_, lists_, rootSlot, sizeof(long), sizeof(size_t), sizeof(int), {}};
+        std::memcpy(&out_[0], &header, sizeof(header));
+        return std::move(out_);
+    }
+    
+private:
+    uint64_t extend(size_t n) {
+        const uint64_t offset = out_.size();
+        out_.resize(offset + n);
+        return offset;
+    }
+    uint64_t align() {
+        out_.resize((out_.size() + 7) / 8 * 8);
+        return out_.size();
+    }
+    uint64_t writeBytes(const void* data, size_t n) {
+        const uint64_t offset = extend(n);
+        std::memcpy(&out_[offset], data, n);
+        return offset;
+    }
+    uint64_t writeString(std::string_view s) {
+        const uint64_t offset = writeBytes(s.data(), s.size());
+        out_.push_back('\0');
+        return offset;
+    }
+    // Sizes and container numbers of slots, records the failure if n does not fit
+    uint32_t slotSize(uint64_t n) {
+        if(n > std::numeric_limits<uint32_t>::max()) {
+            tooLarge_ = true;
+            return 0;
+        }
+        return (uint32_t) n;
+    }
+    
+    template<typename T>
+    void addEntry(const std::string* key, const T& v) {
+        if(node_.count == node_.capacity) return;
+        const uint64_t index = node_.count++;
+        if(key != nullptr) {
+            BinaryKey binaryKey{writeString(*key), key->size()};
+            BinaryMapEntry entry{binaryKey, encodeValue(v)};
+            std::memcpy(&out_[node_.offset + 2 * sizeof(uint64_t) + index * sizeof(BinaryMapEntry)], &entry, sizeof(entry));
+        }
+        else {
+            BinarySlot slot = encodeValue(v);
+            std::memcpy(&out_[node_.offset + sizeof(uint64_t) + index * sizeof(BinarySlot)], &slot, sizeof(slot));
+        }
+    }
+    
+    template<typename T>
+    BinarySlot encodeValue(const T& v) {
+        if constexpr (std::is_base_of_v<ViewableMapValue, T>) {
+            const uint32_t number = slotSize(maps_++);
+            return BinarySlot{BinaryType::Map, number, writeMap(v)};
+        }
+        else if constexpr (std::is_base_of_v<ViewableListValue, T>) {
+            const uint32_t number = slotSize(lists_++);
+            return BinarySlot{BinaryType::List, number, writeList(v)};
+        }
+        else if constexpr (std::is_arithmetic_v<T>) {
+            BinarySlot slot{binaryScalarType<T>(), 0, 0};
+            const binary_scalar_t<T> stored = v;
+            std::memcpy(&slot.payload, &stored, sizeof(stored));
+            return slot;
+        }
+        else if constexpr (std::is_same_v<T, const char*>) {
+            const std::string_view s = v == nullptr ? std::string_view() : std::string_view(v);
+            return BinarySlot{BinaryType::String, slotSize(s.size()), writeString(s)};
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            const std::string_view s = v;
+            return BinarySlot{BinaryType::String, slotSize(s.size()), writeString(s)};
+        }
+        else {
+            // ContiguousDataView
+            using E = typename T::type;
+            align();
+            return BinarySlot{binaryArrayType<E>(), slotSize(v.size), writeBytes(v.data, v.size * sizeof(E))};
+        }
+    }
+    
+    template<typename Container>
+    uint64_t writeMap(const Container& map) {
+        const Node parent = node_;
+        align();
+        // Positions in the index are 32 bit
+        slotSize(map.size());
+        node_ = Node{extend(2 * sizeof(uint64_t) + map.size() * sizeof(BinaryMapEntry)), map.size(), 0};
+        map.iterate(static_cast<ValueViewer<MapIndexType>&>(mapViewer_));
+        const Node node = node_;
+        node_ = parent;
+        
+        // Index of the entries sorted by key
+        std::vector<uint32_t> index(node.count);
+        for(uint32_t i = 0; i < node.count; ++i) index[i] = i;
+        auto keyAt = [this, &node](uint32_t i) {
+            BinaryKey key;
+            std::memcpy(&key, &out_[node.offset + 2 * sizeof(uint64_t) + i * sizeof(BinaryMapEntry)], sizeof(key));
+            return std::string_view(&out_[key.offset], key.size);
+        };
+        std::sort(index.begin(), index.end(), [&keyAt](uint32_t a, uint32_t b) {
+            return keyAt(a) < keyAt(b);
+        });
+        align();
+        const uint64_t header[2] = {node.count, writeBytes(index.data(), index.size() * sizeof(uint32_t))};
+        std::memcpy(&out_[node.offset], header, sizeof(header));
+        return node.offset;
+    }
+    
+    template<typename Container>
+    uint64_t writeList(const Container& list) {
+        const Node parent = node_;
+        align();
+        node_ = Node{extend(sizeof(uint64_t) + list.size() * sizeof(BinarySlot)), list.size(), 0};
+        list.iterate(static_cast<ValueViewer<ListIndexType>&>(listViewer_));
+        const Node node = node_;
+        node_ = parent;
+        std::memcpy(&out_[node.offset], &node.count, sizeof(uint64_t));
+        return node.offset;
+    }
+};
+
+// Encodes a Map or List tree, e.g. to be written to a file and mapped with BinaryDocument::open.
+// Returns an empty string if the tree exceeds the limits of the format.
+template<typename Container>
+std::string encodeBinary(const Container& root) {
+    return BinaryEncoder().encode(root);
+}
+
+// Read only mapping of a file. Without mmap the file is read into memory.
+class MappedFile {
+private:
+    const unsigned char* data_ = nullptr;
+    size_t size_ = 0;
+    std::unique_ptr<unsigned char[]> buffer_;
+    
+public:
+    MappedFile() =default;
+    MappedFile(const MappedFile&) =delete;
+    MappedFile& operator=(const MappedFile&) =delete;
+    ~MappedFile() { close(); }
+    
+    bool open(const char* path) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path, O_RDONLY);
+        if(fd < 0) return false;
+        struct stat info;
+        if(::fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(mapping == MAP_FAILED) return false;
+        data_ = static_cast<const unsigned char*>(mapping);
+        size_ = info.st_size;
+        return true;
+#else
+        std::FILE* file = std::fopen(path, "rb");
+        if(file == nullptr) return false;
+        std::fseek(file, 0, SEEK_END);
+        const long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if(size > 0) {
+            buffer_.reset(new unsigned char[size]);
+            if(std::fread(buffer_.get(), 1, size, file) == (size_t) size) {
+                data_ = buffer_.get();
+                size_ = size;
+            }
+        }
+        std::fclose(file);
+        return data_ != nullptr;
+#endif
+    }
+    
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if(data_ != nullptr) ::munmap(const_cast<unsigned char*>(data_), size_);
+#endif
+        buffer_.reset();
+        data_ = nullptr;
+        size_ = 0;
+    }
+    
+    std::string_view bytes() const {
+        return std::string_view(reinterpret_cast<const char*>(data_), size_);
+    }
+};
+
+// A binary document in a mapped file or in memory. All offsets are validated once when it is opened, 
+// the views do not check them again.
+class BinaryDocument {
+public:
+    static const size_t maxDepth = 512;
+    
+private:
+    MappedFile file_;
+    std::string_view bytes_;
+    BinaryType rootType_ = BinaryType::Map;
+    // Views of all containers by number
+    std::vector<BinaryMapValue> maps_;
+    std::vector<BinaryListValue> lists_;
+    
+public:
+    BinaryDocument() =default;
+    // The views refer to this instance
+    BinaryDocument(const BinaryDocument&) =delete;
+    BinaryDocument& operator=(const BinaryDocument&) =delete;
+    
+    // Maps the file, returns false if it is not a valid document
+    bool open(const char* path) {
+        if(!file_.open(path)) return false;
+        return load(file_.bytes());
+    }
+    
+    // Uses the bytes in place, they have to be 8 byte aligned and outlive the document
+    bool load(std::string_view bytes) {
+        maps_.clear();
+        lists_.clear();
+        bytes_ = bytes;
+        BinaryHeader header;
+        if(bytes.size() < sizeof(header) || reinterpret_cast<uintptr_t>(bytes.data()) % 8 != 0) return false;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if(std::memcmp(header.magic, "CVPB", 4) != 0 || header.version != binaryVersion || header.size != bytes.size()) return false;
+        // Arrays are read in place with the native widths
+        if(header.longSize != sizeof(long) || header.sizeSize != sizeof(size_t) || header.intSize != sizeof(int)) return false;
+        if(header.root.type != BinaryType::Map && header.root.type != BinaryType::List) return false;
+        // Each node has at least 8 bytes, the counts are checked one by one as their sum may wrap around
+        const uint64_t maxNodes = bytes.size() / sizeof(uint64_t);
+        if(header.maps > maxNodes || header.lists > maxNodes - header.maps) return false;
+        maps_.reserve(header.maps);
+        lists_.reserve(header.lists);
+        if(!validateSlot(header.root, 0, 0) || maps_.size() != header.maps || lists_.size() != header.lists) {
+            maps_.clear();
+            lists_.clear();
+            return false;
+        }
+        rootType_ = header.root.type;
+        return true;
+    }
+    
+    // Root container, nullptr if the root has the other type or nothing is loaded
+    const BinaryMapValue* rootMap() const { return rootType_ == BinaryType::Map && !maps_.empty() ? &maps_[0] : nullptr; }
+    const BinaryListValue* rootList() const { return rootType_ == BinaryType::List && !lists_.empty() ? &lists_[0] : nullptr; }
+    
+    // Views of the containers by their number
+    const BinaryMapValue& mapAt(uint32_t i) const { return maps_[i]; }
+    const BinaryListValue& listAt(uint32_t i) const { return lists_[i]; }
+    
+    const unsigned char* base() const { return reinterpret_cast<const unsigned char*>(bytes_.data()); }
+    std::string_view bytes() const { return bytes_; }
+    
+private:
+    // Nodes are written after their parent, hence offsets have to increase, which also excludes cycles.
+    // Views are created in pre-order, the number of each container has to be the next one.
+    bool validateSlot(const BinarySlot& slot, uint64_t parent, size_t depth) {
+        const uint64_t size = bytes_.size();
+        switch(slot.type) {
+            case BinaryType::Long: return validateInteger<long>(slot);
+            case BinaryType::Size: return validateInteger<size_t>(slot);
+            case BinaryType::Int: return validateInteger<int>(slot);
+            case BinaryType::Double: case BinaryType::Float:
+                return true;
+            case BinaryType::Bool:
+                return validateBools(reinterpret_cast<const unsigned char*>(&slot.payload), 1);
+            case BinaryType::String:
+                return validateString(slot.payload, slot.size);
+            case BinaryType::LongArray: return validateArray(slot, sizeof(long));
+            case BinaryType::SizeArray: return validateArray(slot, sizeof(size_t));
+            case BinaryType::IntArray: return validateArray(slot, sizeof(int));
+            case BinaryType::BoolArray: return validateArray(slot, sizeof(bool)) && validateBools(base() + slot.payload, slot.size);
+            case BinaryType::DoubleArray: return validateArray(slot, sizeof(double));
+            case BinaryType::FloatArray: return validateArray(slot, sizeof(float));
+            case BinaryType::Bytes: return validateArray(slot, 1);
+            case BinaryType::List: {
+                if(depth >= maxDepth || slot.payload <= parent || slot.payload % 8 != 0 || slot.payload > size - sizeof(uint64_t)) return false;
+                const uint64_t count = readU64(slot.payload);
+                if(count > (size - slot.payload - sizeof(uint64_t)) / sizeof(BinarySlot)) return false;
+                if(slot.size != lists_.size()) return false;
+                lists_.emplace_back(this, base(), slot.payload);
+                for(uint64_t i = 0; i < count; ++i) {
+                    BinarySlot element;
+                    std::memcpy(&element, bytes_.data() + slot.payload + sizeof(uint64_t) + i * sizeof(BinarySlot), sizeof(element));
+                    if(!validateSlot(element, slot.payload, depth + 1)) return false;
+                }
+                return true;
+            }
+            case BinaryType::Map: {
+                if(depth >= maxDepth || slot.payload <= parent || slot.payload % 8 != 0 || slot.payload > size - 2 * sizeof(uint64_t)) return false;
+                const uint64_t count = readU64(slot.payload);
+                const uint64_t index = readU64(slot.payload + sizeof(uint64_t));
+                if(count > (size - slot.payload - 2 * sizeof(uint64_t)) / sizeof(BinaryMapEntry)) return false;
+                if(index % 4 != 0 || index > size || count > (size - index) / sizeof(uint32_t)) return false;
+                if(slot.size != maps_.size()) return false;
+                maps_.emplace_back(this, base(), slot.payload);
+                for(uint64_t i = 0; i < count; ++i) {
+                    uint32_t position;
+                    std::memcpy(&position, bytes_.data() + index + i * sizeof(uint32_t), sizeof(position));
+                    BinaryMapEntry entry;
+                    std::memcpy(&entry, bytes_.data() + slot.payload + 2 * sizeof(uint64_t) + i * sizeof(BinaryMapEntry), sizeof(entry));
+                    if(position >= count || !validateString(entry.key.offset, entry.key.size) || !validateSlot(entry.value, slot.payload, depth + 1)) return false;
                 }
-            );
-        }, val_);
+                // Lookups are binary searches, the keys have to be strictly ascending in the index. All keys are validated above.
+                return validateIndex(slot.payload, index, count);
+            }
+        }
+        return false;
+    }
+    
+    template<typename T>
+    bool validateInteger(const BinarySlot& slot) const {
+        binary_scalar_t<T> v;
+        std::memcpy(&v, &slot.payload, sizeof(v));
+        return v >= std::numeric_limits<T>::min() && v <= std::numeric_limits<T>::max();
+    }
+    
+    bool validateIndex(uint64_t node, uint64_t index, uint64_t count) const {
+        auto keyAt = [this, node, index](uint64_t i) {
+            uint32_t position;
+            std::memcpy(&position, bytes_.data() + index + i * sizeof(uint32_t), sizeof(position));
+            BinaryKey key;
+            std::memcpy(&key, bytes_.data() + node + 2 * sizeof(uint64_t) + position * sizeof(BinaryMapEntry), sizeof(key));
+            return bytes_.substr(key.offset, key.size);
+        };
+        for(uint64_t i = 1; i < count; ++i) {
+            if(!(keyAt(i - 1) < keyAt(i))) return false;
+        }
+        return true;
+    }
+    
+    bool validateString(uint64_t offset, uint64_t length) const {
+        return offset < bytes_.size() && length < bytes_.size() - offset && bytes_[offset + length] == '\0';
+    }
+    
+    // Other values than 0 and 1 are no valid bool
+    static bool validateBools(const unsigned char* data, size_t size) {
+        return std::all_of(data, data + size, [](unsigned char b) { return b <= 1; });
+    }
+    
+    bool validateArray(const BinarySlot& slot, size_t elementSize) const {
+        return slot.payload % 8 == 0 && slot.payload <= bytes_.size() && slot.size <= (bytes_.size() - slot.payload) / elementSize;
+    }
+    
+    uint64_t readU64(uint64_t offset) const {
+        uint64_t v;
+        std::memcpy(&v, bytes_.data() + offset, sizeof(v));
+        return v;
+    }
+};
+
+template<typename TLIST, typename T, typename Func>
+bool passBinaryScalar(const BinarySlot& slot, Func& func) {
+    if constexpr (alternativeKind<TLIST, T>() == AlternativeKind::Scalar) {
+        binary_scalar_t<T> stored;
+        std::memcpy(&stored, &slot.payload, sizeof(stored));
+        const T v = (T) stored;
+        return func(v);
+    }
+    return true;
+}
+
+template<typename TLIST, typename T, typename Func>
+bool passBinaryArray(const unsigned char* base, const BinarySlot& slot, Func& func) {
+    if constexpr (is_in_type_list<ContiguousDataView<T>, TLIST>::value) {
+        return func(ContiguousDataView<T>{reinterpret_cast<const T*>(base + slot.payload), slot.size});
+    }
+    return true;
+}
+
+// Passes the value of a slot to func, types not accepted by TLIST are skipped
+template<typename TLIST, typename Func>
+bool dispatchBinarySlot(const BinaryDocument& document, const BinarySlot& slot, Func& func) {
+    const unsigned char* base = document.base();
+    switch(slot.type) {
+        case BinaryType::Long: return passBinaryScalar<TLIST, long>(slot, func);
+        case BinaryType::Size: return passBinaryScalar<TLIST, size_t>(slot, func);
+        case BinaryType::Int: return passBinaryScalar<TLIST, int>(slot, func);
+        case BinaryType::Bool: return passBinaryScalar<TLIST, bool>(slot, func);
+        case BinaryType::Double: return passBinaryScalar<TLIST, double>(slot, func);
+        case BinaryType::Float: return passBinaryScalar<TLIST, float>(slot, func);
+        case BinaryType::String:
+            if constexpr (alternativeKind<TLIST, const char*>() == AlternativeKind::Scalar) {
+                return func(reinterpret_cast<const char*>(base + slot.payload));
+            }
+            return true;
+        case BinaryType::LongArray: return passBinaryArray<TLIST, long>(base, slot, func);
+        case BinaryType::SizeArray: return passBinaryArray<TLIST, size_t>(base, slot, func);
+        case BinaryType::IntArray: return passBinaryArray<TLIST, int>(base, slot, func);
+        case BinaryType::BoolArray: return passBinaryArray<TLIST, bool>(base, slot, func);
+        case BinaryType::DoubleArray: return passBinaryArray<TLIST, double>(base, slot, func);
+        case BinaryType::FloatArray: return passBinaryArray<TLIST, float>(base, slot, func);
+        case BinaryType::Bytes: return passBinaryArray<TLIST, unsigned char>(base, slot, func);
+        case BinaryType::List:
+            if constexpr (alternativeKind<TLIST, std::shared_ptr<ViewableListValue>>() == AlternativeKind::Container) {
+                return func(static_cast<const ViewableListValue&>(document.listAt(slot.size)));
+            }
+            return true;
+        case BinaryType::Map:
+            if constexpr (alternativeKind<TLIST, std::shared_ptr<ViewableMapValue>>() == AlternativeKind::Container) {
+                return func(static_cast<const ViewableMapValue&>(document.mapAt(slot.size)));
+            }
+            return true;
+    }
+    return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// Lazy decoding of JSON
+//
+// LazyJsonMap/LazyJsonList index the members of one JSON object/array by scanning the text, nested values 
+// are skipped without being decoded. A value is decoded when visit or iterate reaches it the first time 
+// and cached, nested objects and arrays become LazyJsonMap/LazyJsonList again. Arrays of numbers are 
+// decoded at once to std::vector<long>/std::vector<double>, as readJson does.
+// Indexing copies only the keys, the text has to outlive the containers. Values which cannot be decoded 
+// (invalid JSON, null) are skipped, object members with null are omitted when indexing.
+// Concurrent readers are safe, a value decoded by two threads at once is cached only once.
+// ----------------------------------------------------------------------------
+
+inline bool isJsonWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline size_t skipJsonWhitespace(std::string_view in, size_t pos) {
+    while(pos < in.size() && isJsonWhitespace(in[pos])) ++pos;
+    return pos;
+}
+
+// Returns the end of the value starting at pos without decoding it, std::string_view::npos on error
+inline size_t skipJsonValue(std::string_view in, size_t pos) {
+    size_t depth = 0;
+    while(pos < in.size()) {
+        const char c = in[pos++];
+        if(c == '"') {
+            while(pos < in.size() && in[pos] != '"') pos += in[pos] == '\\' ? 2 : 1;
+            if(pos >= in.size()) return std::string_view::npos;
+            ++pos;
+            if(depth == 0) return pos;
+        }
+        else if(c == '{' || c == '[') {
+            ++depth;
+        }
+        else if(c == '}' || c == ']') {
+            if(depth == 0) return std::string_view::npos;
+            if(--depth == 0) return pos;
+        }
+        else if(depth == 0) {
+            // Numbers and literals end at the next delimiter
+            while(pos < in.size() && in[pos] != ',' && in[pos] != '}' && in[pos] != ']' && !isJsonWhitespace(in[pos])) ++pos;
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Calls func(key, text) for each member of the object or element of the array in, key is empty for arrays. 
+// Keys with escapes are decoded into decodedKeys, which keeps them in place, hence all keys stay valid 
+// as long as in and decodedKeys exist. Returns false if the container is malformed, nested values are not checked.
+template<typename Func>
+bool scanJsonMembers(std::string_view in, std::deque<std::string>& decodedKeys, Func&& func) {
+    if(in.empty() || (in.front() != '{' && in.front() != '[')) return false;
+    const bool isObject = in.front() == '{';
+    const char close = isObject ? '}' : ']';
+    size_t pos = skipJsonWhitespace(in, 1);
+    if(pos < in.size() && in[pos] == close) return true;
+    while(pos < in.size()) {
+        std::string_view key;
+        if(isObject) {
+            if(in[pos] != '"') return false;
+            const size_t keyEnd = skipJsonValue(in, pos);
+            if(keyEnd == std::string_view::npos) return false;
+            key = in.substr(pos + 1, keyEnd - pos - 2);
+            if(key.find('\\') != std::string_view::npos) {
+                std::optional<GenericValueHolder> k;
+                if(!readJson(in.substr(pos, keyEnd - pos), k)) return false;
+                key = decodedKeys.emplace_back(std::move(std::get<std::string>(*k)));
+            }
+            pos = skipJsonWhitespace(in, keyEnd);
+            if(pos >= in.size() || in[pos] != ':') return false;
+            pos = skipJsonWhitespace(in, pos + 1);
+        }
+        const size_t end = skipJsonValue(in, pos);
+        if(end == std::string_view::npos) return false;
+        func(key, in.substr(pos, end - pos));
+        pos = skipJsonWhitespace(in, end);
+        if(pos < in.size() && in[pos] == close) return true;
+        if(pos >= in.size() || in[pos] != ',') return false;
+        pos = skipJsonWhitespace(in, pos + 1);
+    }
+    return false;
+}
+// Same for arrays or if the keys are only used during the calls of func
+template<typename Func>
+bool scanJsonMembers(std::string_view in, Func&& func) {
+    std::deque<std::string> decodedKeys;
+    return scanJsonMembers(in, decodedKeys, std::forward<Func>(func));
+}
+
+template<typename VariantType>
+bool decodeLazyJson(std::string_view text, std::optional<VariantType>& result);
+
+// Decoded values by position, filled on first access
+template<typename VariantType>
+class LazyJsonCache {
+private:
+    size_t size_ = 0;
+    std::unique_ptr<std::atomic<const VariantType*>[]> values_;
+    
+public:
+    LazyJsonCache() =default;
+    LazyJsonCache(const LazyJsonCache&) =delete;
+    LazyJsonCache& operator=(const LazyJsonCache&) =delete;
+    ~LazyJsonCache() {
+        for(size_t i = 0; i < size_; ++i) delete values_[i].load();
+    }
+    
+    void resize(size_t size) {
+        size_ = size;
+        values_.reset(new std::atomic<const VariantType*>[size]());
+    }
+    
+    // Decoded value at position i, nullptr if it cannot be decoded
+    const VariantType* get(size_t i, std::string_view text) const {
+        const VariantType* value = values_[i].load(std::memory_order_acquire);
+        if(value != nullptr) return value;
+        std::optional<VariantType> decoded;
+        if(!decodeLazyJson(text, decoded)) return nullptr;
+        const VariantType* fresh = new VariantType(std::move(*decoded));
+        // Another thread may have decoded the value in the meantime
+        if(values_[i].compare_exchange_strong(value, fresh, std::memory_order_acq_rel)) return fresh;
+        delete fresh;
+        return value;
+    }
+    
+    // Number of values decoded so far
+    size_t decoded() const {
+        size_t n = 0;
+        for(size_t i = 0; i < size_; ++i) n += values_[i].load(std::memory_order_relaxed) != nullptr;
+        return n;
+    }
+};
+
+template<typename VariantType = GenericValueHolder>
+class LazyJsonMap: public CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, LazyJsonMap<VariantType>>, public ViewableMapValue {
+private:
+    // Undecoded text of the values by key
+    FlatStringMap<std::string_view> val_;
+    LazyJsonCache<VariantType> cache_;
+    bool valid_;
+    
+public:
+    // Indexes the object in text, text has to outlive the map
+    explicit LazyJsonMap(std::string_view text) {
+        std::vector<std::pair<std::string_view, std::string_view>> members;
+        // Keys with escapes, referenced by members until they are copied into val_
+        std::deque<std::string> decodedKeys;
+        valid_ = scanJsonMembers(text, decodedKeys, [&members](std::string_view k, std::string_view v) {
+            if(v != "null") members.emplace_back(k, v);
+        });
+        if(!valid_) members.clear();
+        val_ = FlatStringMap<std::string_view>(members.begin(), members.end());
+        cache_.resize(val_.size());
+    }
+    
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, LazyJsonMap<VariantType>>::visit;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, LazyJsonMap<VariantType>>::iterate;
+    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, LazyJsonMap<VariantType>>::size;
+    
+    virtual size_t size() const override {
+        return val_.size();
+    }
+    
+    virtual FlatView<MapIndexType> flat() const override { return FlatView<MapIndexType>(*this); }
+    
+    // False if the object is malformed, it is empty then
+    bool valid() const { return valid_; }
+    size_t decoded() const { return cache_.decoded(); }
+    
+    virtual void visit(std::string_view k, ValueViewer<MapIndexType>& visitor) const override {
+        visit(k, visitor, ValueViewer<MapIndexType>::TypeList{});
+    }
+    template<typename TViewer>
+    void visit(const char* k, TViewer& visitor) const {
+        visit(std::string_view(k), visitor, typename TViewer::TypeList{});
+    }
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(std::string_view k, TViewer& visitor, TLIST = TLIST{}) const {
+        const auto* entry = val_.find(k);
+        if(entry == nullptr) return;
+        handleEntry(entry - &*val_.begin(), visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, val_.size(), visitor, TLIST{});
+    }
+    
+    // Iterates the entries [first, last) in document order, the bounds are clamped to size(). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(size_t first, size_t last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, size());
+        first = std::min(first, last);
+        for(size_t i = first; i < last; ++i) {
+            if(!handleEntry(i, visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    template<typename TViewer, typename TLIST>
+    bool handleEntry(size_t i, TViewer& visitor, TLIST) const {
+        const auto& entry = *(val_.begin() + i);
+        const VariantType* value = cache_.get(i, entry.second);
+        if(value == nullptr) return true;
+        return dispatchVariant<TLIST>(*value, [&entry, &visitor](const auto& v){
+            return visitor.handle(entry.first, v);
+        });
+    }
+};
+
+template<typename VariantType = GenericValueHolder>
+class LazyJsonList: public CRTPVisitable<ViewableList<ValueViewer<ListIndexType>>, LazyJsonList<VariantType>>, public ViewableListValue {
+private:
+    // Undecoded text of the elements
+    std::vector<std::string_view> val_;
+    LazyJsonCache<VariantType> cache_;
+    bool valid_;
+    
+public:
+    // Indexes the array in text, text has to outlive the list
+    explicit LazyJsonList(std::string_view text) {
+        valid_ = scanJsonMembers(text, [this](std::string_view, std::string_view v) {
+            val_.push_back(v);
+        });
+        if(!valid_) val_.clear();
+        cache_.resize(val_.size());
+    }
+    
+    using ViewableListValue::visit;
+    using ViewableListValue::iterate;
+    using ViewableListValue::size;
+    
+    virtual size_t size() const override {
+        return val_.size();
+    }
+    
+    virtual FlatView<ListIndexType> flat() const override { return FlatView<ListIndexType>(*this); }
+    
+    // False if the array is malformed, it is empty then
+    bool valid() const { return valid_; }
+    size_t decoded() const { return cache_.decoded(); }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
+    void visit(ListIndexType i, TViewer& visitor, TLIST = TLIST{}) const {
+        if(i < 0 || (size_t) i >= val_.size()) return;
+        handleElement(i, visitor, TLIST{});
+    }
+    
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
+        iterateRange(0, val_.size(), visitor, TLIST{});
+    }
+    
+    // Iterates the elements [first, last), the bounds are clamped to [0, size()). Returns false if the visitor stopped the iteration
+    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
+    bool iterateRange(ListIndexType first, ListIndexType last, TViewer& visitor, TLIST = TLIST{}) const {
+        last = std::min(last, (ListIndexType) size());
+        first = std::max<ListIndexType>(first, 0);
+        for(long i = first; i < last; ++i) {
+            if(!handleElement(i, visitor, TLIST{})) return false;
+        }
+        return true;
+    }
+    
+private:
+    template<typename TViewer, typename TLIST>
+    bool handleElement(ListIndexType i, TViewer& visitor, TLIST) const {
+        const VariantType* value = cache_.get(i, val_[i]);
+        if(value == nullptr) return true;
+        return dispatchVariant<TLIST>(*value, [&i, &visitor](const auto& v){
+            return visitor.handle(i, v);
+        });
     }
 };
 
+// Decodes one value: objects and arrays (except arrays of numbers) lazily, everything else with readJson
+template<typename VariantType>
+bool decodeLazyJson(std::string_view text, std::optional<VariantType>& result) {
+    if(text.empty()) return false;
+    if(text.front() == '{') {
+        auto map = std::make_shared<LazyJsonMap<VariantType>>(text);
+        if(!map->valid()) return false;
+        result.emplace(std::shared_ptr<ViewableMapValue>(std::move(map)));
+        return true;
+    }
+    if(text.front() == '[') {
+        bool numbers = true;
+        bool empty = true;
+        const bool valid = scanJsonMembers(text, [&numbers, &empty](std::string_view, std::string_view v) {
+            empty = false;
+            numbers = numbers && (v.front() == '-' || (v.front() >= '0' && v.front() <= '9'));
+        });
+        if(!valid) return false;
+        if(!numbers || empty) {
+            result.emplace(std::shared_ptr<ViewableListValue>(std::make_shared<LazyJsonList<VariantType>>(text)));
+            return true;
+        }
+    }
+    return readJson(text, result);
+}
 
+// Indexes the JSON document in input without decoding it, input has to outlive result
 template<typename VariantType = GenericValueHolder>
-class Map: public CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>, public ViewableMapValue {
+bool readJsonLazy(std::string_view input, std::optional<VariantType>& result) {
+    const size_t first = skipJsonWhitespace(input, 0);
+    const size_t last = first < input.size() ? skipJsonValue(input, first) : std::string_view::npos;
+    if(last == std::string_view::npos || skipJsonWhitespace(input, last) != input.size()) return false;
+    return decodeLazyJson(input.substr(first, last - first), result);
+}
+
+
+// ----------------------------------------------------------------------------
+// MessagePack
+//
+// MsgPackWriter encodes a value tree with one viewer instance for all depths, MsgPackReader is a streaming 
+// reader with the handler interface of JsonReader, so TreeBuilder builds trees from both. Integers use 
+// the smallest encoding, ContiguousDataView<unsigned char> is written as bin and the other numeric 
+// ContiguousDataViews as typed array extensions. Typed arrays are portable: the elements are big-endian 
+// with a fixed width (int64, uint64, int32, float32, float64, see msgPackArrayType). Their payload starts 
+// with a number of padding bytes which align the elements relative to the start of the buffer, hence on 
+// big-endian machines the reader passes them in place if the buffer is aligned, elsewhere they are converted.
+// Bin data is always passed in place.
+// ----------------------------------------------------------------------------
+
+// Extension types of typed arrays, 0 if not supported
+template<typename T>
+constexpr int8_t msgPackArrayType() {
+    if constexpr (std::is_same_v<T, long>) return 1;
+    else if constexpr (std::is_same_v<T, size_t>) return 2;
+    else if constexpr (std::is_same_v<T, int>) return 3;
+    else if constexpr (std::is_same_v<T, float>) return 4;
+    else if constexpr (std::is_same_v<T, double>) return 5;
+    else return 0;
+}
+
+// Element type of the typed array extension of T, independent of the platform
+template<typename T>
+using msgpack_array_element_t = conditional_t<std::is_same_v<T, long>, int64_t, conditional_t<std::is_same_v<T, size_t>, uint64_t, conditional_t<std::is_same_v<T, int>, int32_t, T>>>;
+
+static_assert(sizeof(float) == 4 && sizeof(double) == 8, "typed arrays of MessagePack need IEEE 754 float and double");
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+constexpr bool msgPackNativeBigEndian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+#else
+constexpr bool msgPackNativeBigEndian = false;
+#endif
+
+class MsgPackWriter {
 private:
-    std::unordered_map<std::string, VariantType> val_;
+    struct MapEntries {
+        MsgPackWriter* self;
+        
+        template<typename T>
+        bool operator()(MapIndexType k, const T& v) const {
+            self->writeString(k);
+            self->writeValue(v);
+            ++self->count_;
+            return true;
+        }
+    };
+    struct ListElements {
+        MsgPackWriter* self;
+        
+        template<typename T>
+        bool operator()(ListIndexType, const T& v) const {
+            self->writeValue(v);
+            ++self->count_;
+            return true;
+        }
+    };
+    
+    std::string& out_;
+    // Values written into the innermost container
+    size_t count_ = 0;
+    FreeVisitor<ValueViewer<MapIndexType>, MapEntries> mapViewer_;
+    FreeVisitor<ValueViewer<ListIndexType>, ListElements> listViewer_;
     
 public:
-    virtual ~Map() =default;
+    explicit MsgPackWriter(std::string& out): out_(out), mapViewer_(MapEntries{this}), listViewer_(ListElements{this}) {}
+    // Both viewers refer to this instance
+    MsgPackWriter(const MsgPackWriter&) =delete;
+    MsgPackWriter& operator=(const MsgPackWriter&) =delete;
     
-    Map(std::initializer_list<std::pair<const std::string, VariantType>> l): val_{l} {}
+    // Appends containers, scalars and ContiguousDataViews to the output
+    template<typename T>
+    void write(const T& v) {
+        writeValue(v);
+    }
     
-    // Load rvalue overloads
-    // using ViewableMapValue::visit;
-    // using ViewableMapValue::iterate;
-    // using ViewableMapValue::size;
+private:
+    void append(unsigned char c) {
+        out_.push_back((char) c);
+    }
+    void appendBigEndian(uint64_t v, size_t bytes) {
+        for(size_t i = bytes; i > 0; --i) append((unsigned char) (v >> (8 * (i - 1))));
+    }
+    void appendBytes(const void* data, size_t size) {
+        out_.append(static_cast<const char*>(data), size);
+    }
     
-    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::visit;
-    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::iterate;
-    using CRTPVisitable<ViewableMap<ValueViewer<MapIndexType>>, Map<VariantType>>::size;
+    // Type byte c8, c16 or c32 followed by the size, for sizes below 256 (or fixLimit for fix types) the smallest
+    size_t encodeHeader(unsigned char* header, size_t size, unsigned char fix, size_t fixLimit, unsigned char c8, unsigned char c16, unsigned char c32) const {
+        size_t bytes = 0;
+        if(size < fixLimit) {
+            header[0] = fix | (unsigned char) size;
+            return 1;
+        }
+        if(c8 != 0 && size <= 0xff) {
+            header[0] = c8;
+            bytes = 1;
+        }
+        else if(size <= 0xffff) {
+            header[0] = c16;
+            bytes = 2;
+        }
+        else {
+            header[0] = c32;
+            bytes = 4;
+        }
+        for(size_t i = 0; i < bytes; ++i) header[1 + i] = (unsigned char) (size >> (8 * (bytes - 1 - i)));
+        return 1 + bytes;
+    }
+    void writeHeader(size_t size, unsigned char fix, size_t fixLimit, unsigned char c8, unsigned char c16, unsigned char c32) {
+        unsigned char header[5];
+        appendBytes(header, encodeHeader(header, size, fix, fixLimit, c8, c16, c32));
+    }
     
-    virtual size_t size() const override{
-        return val_.size();
-    };
+    void writeSigned(int64_t v) {
+        if(v >= 0) {
+            writeUnsigned(v);
+        }
+        else if(v >= -32) {
+            append((unsigned char) v);
+        }
+        else if(v >= INT8_MIN) {
+            append(0xd0);
+            appendBigEndian((uint64_t) v, 1);
+        }
+        else if(v >= INT16_MIN) {
+            append(0xd1);
+            appendBigEndian((uint64_t) v, 2);
+        }
+        else if(v >= INT32_MIN) {
+            append(0xd2);
+            appendBigEndian((uint64_t) v, 4);
+        }
+        else {
+            append(0xd3);
+            appendBigEndian((uint64_t) v, 8);
+        }
+    }
     
-    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
-    void visit(MapIndexType k, TViewer& visitor, TLIST = TLIST{}) const {
-        auto it = val_.find(k);
-        if(it == val_.end()) return;
-        std::visit([&k, &visitor](const auto& v){
-            callFirstOfType(v,
-                // Check if v is a scalar value
-                intersect_type_list_t<TLIST, ScalarValueViewer<MapIndexType>::TypeList>{}, [&k, &visitor](const auto& scalar){
-                    visitor.handle(k, scalar);
-                },
-                // if not, check if is v contiguous array
-                predicate_template<test_for_contiguous_data>{}, intersect_type_list_t<TLIST, ContiguousValueViewer<MapIndexType>::TypeList>{}, [&k, &visitor](const auto& vector){
-                    using VT = decay_t<decltype(vector[0])>;
-                    visitor.handle(k, ContiguousDataView<VT>{vector.data(), vector.size()});
-                },
-                // if not, check if is v is one of the container classes wrapped in a smart pointer.
-                predicate_template<test_for_smartpointer>{}, intersect_type_list_t<TLIST, ContainerValueViewer<MapIndexType>::TypeList>{}, [&k, &visitor](const auto& upointer){
-                    visitor.handle(k, *upointer.get());
-                }
-            );
-        }, it->second);
+    void writeUnsigned(uint64_t v) {
+        if(v < 0x80) {
+            append((unsigned char) v);
+        }
+        else if(v <= 0xff) {
+            append(0xcc);
+            appendBigEndian(v, 1);
+        }
+        else if(v <= 0xffff) {
+            append(0xcd);
+            appendBigEndian(v, 2);
+        }
+        else if(v <= 0xffffffff) {
+            append(0xce);
+            appendBigEndian(v, 4);
+        }
+        else {
+            append(0xcf);
+            appendBigEndian(v, 8);
+        }
     }
     
-    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
-    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
-        for(const auto& p: val_) {
-            bool cont = true;
-            std::visit([&cont, &k = p.first, &visitor](auto&& v){
-                // std::cout << "Iterate " << type_name<TLIST>() << " for " << k << "(" << type_name<decltype(v)>() << ")" << std::endl;
-                // std::cout << "intersect container: " << type_name<intersect_type_list_t<TLIST, ContainerValueViewer<MapIndexType>::TypeList>>() << std::endl;
-                callFirstOfType(v,
-                    // Check if v is a scalar value
-                    intersect_type_list_t<TLIST, ScalarValueViewer<MapIndexType>::TypeList>{}, [&cont, &k, &visitor](const auto& scalar){
-                        cont = visitor.handle(k, scalar);
-                    },
-                    // if not, check if is v contiguous array
-                    predicate_template<test_for_contiguous_data>{}, intersect_type_list_t<TLIST, ContiguousValueViewer<MapIndexType>::TypeList>{}, [&cont, &k, &visitor](const auto& vector){
-                        using VT = decay_t<decltype(vector[0])>;
-                        cont = visitor.handle(k, ContiguousDataView<VT>{vector.data(), vector.size()});
-                    },
-                    // if not, check if is v is one of the container classes wrapped in a smart pointer.
-                    predicate_template<test_for_smartpointer>{}, intersect_type_list_t<TLIST, ContainerValueViewer<MapIndexType>::TypeList>{}, [&cont, &k, &visitor](const auto& upointer){
-                        cont = visitor.handle(k, *upointer.get());
-                    }
-                );
-            }, p.second);
-
-            if(!cont) return;
+    void writeString(std::string_view s) {
+        writeHeader(s.size(), 0xa0, 32, 0xd9, 0xda, 0xdb);
+        appendBytes(s.data(), s.size());
+    }
+    
+    template<typename T>
+    void writeValue(const T& v) {
+        if constexpr (std::is_base_of_v<ViewableMapValue, T>) {
+            writeContainer(v, 0x80, 0xde, 0xdf, static_cast<ValueViewer<MapIndexType>&>(mapViewer_));
+        }
+        else if constexpr (std::is_base_of_v<ViewableListValue, T>) {
+            writeContainer(v, 0x90, 0xdc, 0xdd, static_cast<ValueViewer<ListIndexType>&>(listViewer_));
+        }
+        else if constexpr (std::is_same_v<T, bool>) {
+            append(v ? 0xc3 : 0xc2);
+        }
+        else if constexpr (std::is_same_v<T, float>) {
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            append(0xca);
+            appendBigEndian(bits, 4);
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            uint64_t bits;
+            const double d = v;
+            std::memcpy(&bits, &d, sizeof(bits));
+            append(0xcb);
+            appendBigEndian(bits, 8);
+        }
+        else if constexpr (std::is_signed_v<T>) {
+            writeSigned(v);
+        }
+        else if constexpr (std::is_unsigned_v<T>) {
+            writeUnsigned(v);
+        }
+        else if constexpr (std::is_same_v<T, const char*>) {
+            writeString(v == nullptr ? std::string_view() : std::string_view(v));
+        }
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            writeString(v);
+        }
+        else if constexpr (std::is_same_v<T, ContiguousDataView<unsigned char>>) {
+            writeHeader(v.size, 0, 0, 0xc4, 0xc5, 0xc6);
+            appendBytes(v.data, v.size);
+        }
+        else if constexpr (msgPackArrayType<typename T::type>() != 0) {
+            writeTypedArray(v);
+        }
+        else {
+            // No extension type (bool), written as array
+            writeHeader(v.size, 0x90, 16, 0, 0xdc, 0xdd);
+            for(size_t i = 0; i < v.size; ++i) writeValue(v.data[i]);
+        }
+    }
+    
+    template<typename T>
+    void writeTypedArray(ContiguousDataView<T> v) {
+        using E = msgpack_array_element_t<T>;
+        const size_t bytes = v.size * sizeof(E);
+        const size_t maxPayload = 1 + alignof(E) - 1 + bytes;
+        const size_t headerSize = maxPayload <= 0xff ? 3 : (maxPayload <= 0xffff ? 4 : 6);
+        const size_t padding = (alignof(E) - (out_.size() + headerSize + 1) % alignof(E)) % alignof(E);
+        const size_t payload = 1 + padding + bytes;
+        if(headerSize == 3) {
+            append(0xc7);
+            appendBigEndian(payload, 1);
+        }
+        else if(headerSize == 4) {
+            append(0xc8);
+            appendBigEndian(payload, 2);
+        }
+        else {
+            append(0xc9);
+            appendBigEndian(payload, 4);
+        }
+        append((unsigned char) msgPackArrayType<T>());
+        append((unsigned char) padding);
+        out_.append(padding, '\0');
+        if constexpr (msgPackNativeBigEndian && sizeof(E) == sizeof(T)) {
+            appendBytes(v.data, bytes);
+        }
+        else {
+            for(size_t i = 0; i < v.size; ++i) {
+                const E element = (E) v.data[i];
+                uint64_t bits = 0;
+                std::memcpy(&bits, &element, sizeof(E));
+                appendBigEndian(bits, sizeof(E));
+            }
+        }
+    }
+    
+    template<typename Container, typename Viewer>
+    void writeContainer(const Container& v, unsigned char fix, unsigned char c16, unsigned char c32, Viewer& viewer) {
+        const size_t expected = v.size();
+        const size_t headerPos = out_.size();
+        writeHeader(expected, fix, 16, 0, c16, c32);
+        const size_t headerSize = out_.size() - headerPos;
+        const size_t outerCount = count_;
+        count_ = 0;
+        v.iterate(viewer);
+        const size_t written = count_;
+        count_ = outerCount;
+        if(written != expected) {
+            // Values were skipped (e.g. undecodable values of LazyJsonMap), typed arrays behind may lose their alignment
+            unsigned char header[5];
+            const size_t size = encodeHeader(header, written, fix, 16, 0, c16, c32);
+            out_.replace(headerPos, headerSize, reinterpret_cast<const char*>(header), size);
         }
     }
 };
 
+// Encodes a value as MessagePack
+template<typename T>
+std::string writeMsgPack(const T& v) {
+    std::string out;
+    MsgPackWriter(out).write(v);
+    return out;
+}
 
-template<typename VariantType = GenericValueHolder>
-class List: public CRTPVisitable<ViewableList<ValueViewer<ListIndexType>>, List<VariantType>>, public ViewableListValue {
+// Handler interface of MsgPackReader, the one of JsonReader and
+//   bool integer(size_t);                                       unsigned integers exceeding long
+//   bool bytes(ContiguousDataView<unsigned char>);              bin
+//   template<typename T> bool array(ContiguousDataView<T>);     typed array extensions in the input
+//   template<typename T> bool array(std::vector<T>&&);          typed array extensions converted to T
+// Strings and binary data refer to the input, typed arrays as well if they are aligned and need no conversion.
+class MsgPackReader {
+public:
+    static const size_t maxDepth = 512;
+    
 private:
-    std::vector<VariantType> val_;
+    std::string_view in_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;
+    std::string error_;
     
 public:
-    virtual ~List() =default;
+    explicit MsgPackReader(std::string_view input): in_(input) {}
+    MsgPackReader(const MsgPackReader&) =delete;
+    MsgPackReader& operator=(const MsgPackReader&) =delete;
     
-    // template<typename ...TS>
-    // List(TS&& ...vs): val_(std::forward<TS>(vs)...) {}
-    List(std::initializer_list<VariantType> l): val_{l} {}
+    // Parses exactly one value, returns false if the input is invalid or if the handler aborted
+    template<typename Handler>
+    bool parse(Handler& handler) {
+        pos_ = 0;
+        depth_ = 0;
+        error_.clear();
+        if(!parseValue(handler)) return false;
+        if(pos_ != in_.size()) return fail("unexpected bytes after the value");
+        return true;
+    }
     
-    // Load rvalue overloads
-    using ViewableListValue::visit;
-    using ViewableListValue::iterate;
-    using ViewableListValue::size;
+    const std::string& error() const { return error_; }
+    size_t errorOffset() const { return pos_; }
     
-    virtual size_t size() const override {
-        return val_.size();
-    };
+private:
+    bool fail(const char* message) {
+        if(error_.empty()) error_ = message;
+        return false;
+    }
     
-    template<typename TViewer, typename TLIST = typename TViewer::TypeList>
-    void visit(ListIndexType i, TViewer& visitor, TLIST = TLIST{}) const {
-        if(i < 0 || i >= val_.size()) return;
-        std::visit([&i, &visitor](const auto& v){
-            callFirstOfType(v,
-                // Check if v is a scalar value
-                intersect_type_list_t<TLIST, ScalarValueViewer<MapIndexType>::TypeList>{}, [&i, &visitor](const auto& scalar){
-                    visitor.handle(i, scalar);
-                },
-                // if not, check if is v contiguous array
-                predicate_template<test_for_contiguous_data>{}, intersect_type_list_t<TLIST, ContiguousValueViewer<MapIndexType>::TypeList>{}, [&i, &visitor](const auto& vector){
-                    using VT = decay_t<decltype(vector[0])>;
-                    visitor.handle(i, ContiguousDataView<VT>{vector.data(), vector.size()});
-                },
-                // if not, check if is v is one of the container classes wrapped in a smart pointer.
-                predicate_template<test_for_smartpointer>{}, intersect_type_list_t<TLIST, ContainerValueViewer<MapIndexType>::TypeList>{}, [&i, &visitor](const auto& upointer){
-                    visitor.handle(i, *upointer.get());
-                }
-            );
-        }, val_[i]);
+    bool need(size_t n) {
+        return n <= in_.size() - pos_ || fail("unexpected end of input");
     }
     
-    template<typename TViewer, typename TLIST = typename TViewer::TypeList> 
-    void iterate(TViewer& visitor, TLIST = TLIST{}) const {
-        for(long i = 0; i < val_.size(); ++i) {
-            bool cont = true;
-            std::visit([&cont, &i, &visitor](auto&& v){
-                callFirstOfType(v,
-                    // Check if v is a scalar value
-                    intersect_type_list_t<TLIST, ScalarValueViewer<MapIndexType>::TypeList>{}, [&cont, &i, &visitor](const auto& scalar){
-                        cont = visitor.handle(i, scalar);
-                    },
-                    // if not, check if is v contiguous array
-                    predicate_template<test_for_contiguous_data>{}, intersect_type_list_t<TLIST, ContiguousValueViewer<MapIndexType>::TypeList>{}, [&cont, &i, &visitor](const auto& vector){
-                        using VT = decay_t<decltype(vector[0])>;
-                        cont = visitor.handle(i, ContiguousDataView<VT>{vector.data(), vector.size()});
-                    },
-                    // if not, check if is v is one of the container classes wrapped in a smart pointer.
-                    predicate_template<test_for_smartpointer>{}, intersect_type_list_t<TLIST, ContainerValueViewer<MapIndexType>::TypeList>{}, [&cont, &i, &visitor](const auto& upointer){
-                        cont = visitor.handle(i, *upointer.get());
-                    }
-                );
-            }, val_[i]);
-            if(!cont) return;
+    const unsigned char* data() const {
+        return reinterpret_cast<const unsigned char*>(in_.data()) + pos_;
+    }
+    
+    uint64_t readBigEndian(size_t bytes) {
+        uint64_t v = 0;
+        for(size_t i = 0; i < bytes; ++i) v = (v << 8) | data()[i];
+        pos_ += bytes;
+        return v;
+    }
+    
+    // Reads a size of 1, 2 or 4 bytes
+    bool readSize(size_t bytes, size_t& size) {
+        if(!need(bytes)) return false;
+        size = readBigEndian(bytes);
+        return true;
+    }
+    
+    template<typename Handler>
+    bool parseValue(Handler& handler) {
+        if(!need(1)) return false;
+        const unsigned char c = data()[0];
+        ++pos_;
+        size_t size = 0;
+        if(c <= 0x7f) return handler.integer((long) c) || fail("aborted by handler");
+        if(c >= 0xe0) return handler.integer((long) (int8_t) c) || fail("aborted by handler");
+        if((c & 0xf0) == 0x80) return parseMap(handler, c & 0x0f);
+        if((c & 0xf0) == 0x90) return parseArray(handler, c & 0x0f);
+        if((c & 0xe0) == 0xa0) return parseString(handler, c & 0x1f);
+        switch(c) {
+            case 0xc0: return handler.null() || fail("aborted by handler");
+            case 0xc2: return handler.boolean(false) || fail("aborted by handler");
+            case 0xc3: return handler.boolean(true) || fail("aborted by handler");
+            case 0xc4: return readSize(1, size) && parseBytes(handler, size);
+            case 0xc5: return readSize(2, size) && parseBytes(handler, size);
+            case 0xc6: return readSize(4, size) && parseBytes(handler, size);
+            case 0xc7: return readSize(1, size) && parseExtension(handler, size);
+            case 0xc8: return readSize(2, size) && parseExtension(handler, size);
+            case 0xc9: return readSize(4, size) && parseExtension(handler, size);
+            case 0xca: {
+                if(!need(4)) return false;
+                const uint32_t bits = (uint32_t) readBigEndian(4);
+                float v;
+                std::memcpy(&v, &bits, sizeof(v));
+                return handler.real(v) || fail("aborted by handler");
+            }
+            case 0xcb: {
+                if(!need(8)) return false;
+                const uint64_t bits = readBigEndian(8);
+                double v;
+                std::memcpy(&v, &bits, sizeof(v));
+                return handler.real(v) || fail("aborted by handler");
+            }
+            case 0xcc: return parseUnsigned(handler, 1);
+            case 0xcd: return parseUnsigned(handler, 2);
+            case 0xce: return parseUnsigned(handler, 4);
+            case 0xcf: return parseUnsigned(handler, 8);
+            case 0xd0: return parseSigned(handler, 1);
+            case 0xd1: return parseSigned(handler, 2);
+            case 0xd2: return parseSigned(handler, 4);
+            case 0xd3: return parseSigned(handler, 8);
+            case 0xd4: return parseExtension(handler, 1);
+            case 0xd5: return parseExtension(handler, 2);
+            case 0xd6: return parseExtension(handler, 4);
+            case 0xd7: return parseExtension(handler, 8);
+            case 0xd8: return parseExtension(handler, 16);
+            case 0xd9: return readSize(1, size) && parseString(handler, size);
+            case 0xda: return readSize(2, size) && parseString(handler, size);
+            case 0xdb: return readSize(4, size) && parseString(handler, size);
+            case 0xdc: return readSize(2, size) && parseArray(handler, size);
+            case 0xdd: return readSize(4, size) && parseArray(handler, size);
+            case 0xde: return readSize(2, size) && parseMap(handler, size);
+            case 0xdf: return readSize(4, size) && parseMap(handler, size);
+            default: return fail("invalid type");
+        }
+    }
+    
+    template<typename Handler>
+    bool parseUnsigned(Handler& handler, size_t bytes) {
+        if(!need(bytes)) return false;
+        const uint64_t v = readBigEndian(bytes);
+        if(v > (uint64_t) std::numeric_limits<long>::max()) return handler.integer((size_t) v) || fail("aborted by handler");
+        return handler.integer((long) v) || fail("aborted by handler");
+    }
+    
+    template<typename Handler>
+    bool parseSigned(Handler& handler, size_t bytes) {
+        if(!need(bytes)) return false;
+        uint64_t v = readBigEndian(bytes);
+        // Sign extension
+        if(bytes < 8 && (v >> (8 * bytes - 1)) != 0) v |= ~uint64_t(0) << (8 * bytes);
+        return handler.integer((long) (int64_t) v) || fail("aborted by handler");
+    }
+    
+    bool readString(size_t size, std::string_view& s) {
+        if(!need(size)) return false;
+        s = in_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+    
+    template<typename Handler>
+    bool parseString(Handler& handler, size_t size) {
+        std::string_view s;
+        return readString(size, s) && (handler.string(s) || fail("aborted by handler"));
+    }
+    
+    template<typename Handler>
+    bool parseBytes(Handler& handler, size_t size) {
+        if(!need(size)) return false;
+        const ContiguousDataView<unsigned char> v{data(), size};
+        pos_ += size;
+        return handler.bytes(v) || fail("aborted by handler");
+    }
+    
+    template<typename Handler>
+    bool parseExtension(Handler& handler, size_t size) {
+        if(!need(1 + size)) return false;
+        const int8_t type = (int8_t) data()[0];
+        ++pos_;
+        const unsigned char* payload = data();
+        pos_ += size;
+        switch(type) {
+            case msgPackArrayType<long>(): return parseTypedArray<long>(handler, payload, size);
+            case msgPackArrayType<size_t>(): return parseTypedArray<size_t>(handler, payload, size);
+            case msgPackArrayType<int>(): return parseTypedArray<int>(handler, payload, size);
+            case msgPackArrayType<float>(): return parseTypedArray<float>(handler, payload, size);
+            case msgPackArrayType<double>(): return parseTypedArray<double>(handler, payload, size);
+            default: return fail("unsupported extension type");
+        }
+    }
+    
+    template<typename T, typename Handler>
+    bool parseTypedArray(Handler& handler, const unsigned char* payload, size_t size) {
+        using E = msgpack_array_element_t<T>;
+        if(size == 0 || payload[0] >= alignof(E) || size_t(1 + payload[0]) > size) return fail("invalid typed array");
+        const size_t bytes = size - 1 - payload[0];
+        if(bytes % sizeof(E) != 0) return fail("invalid typed array");
+        const unsigned char* elements = payload + 1 + payload[0];
+        if constexpr (msgPackNativeBigEndian && sizeof(E) == sizeof(T)) {
+            if(reinterpret_cast<uintptr_t>(elements) % alignof(T) == 0) {
+                return handler.array(ContiguousDataView<T>{reinterpret_cast<const T*>(elements), bytes / sizeof(T)}) || fail("aborted by handler");
+            }
+        }
+        std::vector<T> converted(bytes / sizeof(E));
+        for(size_t i = 0; i < converted.size(); ++i) {
+            uint64_t bits = 0;
+            for(size_t b = 0; b < sizeof(E); ++b) bits = (bits << 8) | elements[i * sizeof(E) + b];
+            E element;
+            if constexpr (sizeof(E) == 4) {
+                const uint32_t narrow = (uint32_t) bits;
+                std::memcpy(&element, &narrow, sizeof(E));
+            }
+            else {
+                std::memcpy(&element, &bits, sizeof(E));
+            }
+            if constexpr (std::is_integral_v<E> && sizeof(T) < sizeof(E)) {
+                if(element < (E) std::numeric_limits<T>::min() || element > (E) std::numeric_limits<T>::max()) return fail("typed array element out of range");
+            }
+            converted[i] = (T) element;
+        }
+        return handler.array(std::move(converted)) || fail("aborted by handler");
+    }
+    
+    template<typename Handler>
+    bool parseArray(Handler& handler, size_t size) {
+        if(++depth_ > maxDepth) return fail("nesting too deep");
+        // Each element has at least one byte
+        if(size > in_.size() - pos_) return fail("unexpected end of input");
+        if(!handler.startArray()) return fail("aborted by handler");
+        for(size_t i = 0; i < size; ++i) {
+            if(!parseValue(handler)) return false;
+        }
+        --depth_;
+        return handler.endArray() || fail("aborted by handler");
+    }
+    
+    template<typename Handler>
+    bool parseMap(Handler& handler, size_t size) {
+        if(++depth_ > maxDepth) return fail("nesting too deep");
+        if(size > (in_.size() - pos_) / 2) return fail("unexpected end of input");
+        if(!handler.startObject()) return fail("aborted by handler");
+        for(size_t i = 0; i < size; ++i) {
+            if(!need(1)) return false;
+            const unsigned char c = data()[0];
+            ++pos_;
+            size_t keySize = 0;
+            if((c & 0xe0) == 0xa0) keySize = c & 0x1f;
+            else if(c == 0xd9 && readSize(1, keySize)) {}
+            else if(c == 0xda && readSize(2, keySize)) {}
+            else if(c == 0xdb && readSize(4, keySize)) {}
+            else return fail("map keys have to be strings");
+            std::string_view k;
+            if(!readString(keySize, k)) return false;
+            if(!handler.key(k)) return fail("aborted by handler");
+            if(!parseValue(handler)) return false;
         }
+        --depth_;
+        return handler.endObject() || fail("aborted by handler");
     }
 };
 
+template<typename VariantType>
+bool readMsgPack(std::string_view input, TreeBuilder<VariantType>& builder, std::optional<VariantType>& result, std::string* error) {
+    MsgPackReader reader(input);
+    if(!reader.parse(builder)) {
+        if(error != nullptr) *error = (builder.error() != nullptr ? std::string(builder.error()) : reader.error()) + " at offset " + std::to_string(reader.errorOffset());
+        return false;
+    }
+    result = std::move(builder.result());
+    return true;
+}
+
+// Decodes a MessagePack value into result, returns false and sets error (if not null) on failure.
+// Binary data and typed arrays are copied.
+template<typename VariantType = GenericValueHolder>
+bool readMsgPack(std::string_view input, std::optional<VariantType>& result, std::string* error = nullptr) {
+    TreeBuilder<VariantType> builder;
+    return readMsgPack(input, builder, result, error);
+}
+// Same, binary data and typed arrays in place are adopted as ExternalArray sharing the ownership of input
+template<typename VariantType = GenericValueHolder>
+bool readMsgPack(std::shared_ptr<const std::string> input, std::optional<VariantType>& result, std::string* error = nullptr) {
+    const std::string_view bytes = *input;
+    TreeBuilder<VariantType> builder(std::move(input));
+    return readMsgPack(bytes, builder, result, error);
+}
+
     
     
     
@@ -2004,11 +7486,39 @@ inline std::string depthString(int depth) {
 
 # include <iomanip>
 inline void printData(std::ostream& out, const unsigned char* data, size_t len) {
-    for(int i=0; i<len; ++i) { 
+    for(size_t i=0; i<len; ++i) { 
         out << std::setw(2) << std::setfill('0') << std::hex << (int) data[i] << " ";
     }
 }
                     
+// Sum and count of all numbers, the state is held by value to be usable with parallelIterate
+struct NumberStatistics {
+    double sum = 0;
+    size_t count = 0;
+    
+    template<typename T>
+    bool operator()(ListIndexType, const T& v) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            sum += v;
+            ++count;
+        }
+        return true;
+    }
+};
+
+// Paths of all values in traversal order
+struct PathCollector {
+    std::vector<std::string> paths;
+    
+    template<typename T>
+    bool operator()(const TraversalContext& context, const T&) {
+        std::ostringstream out;
+        out << context;
+        paths.push_back(out.str());
+        return true;
+    }
+};
+
 int testGenericValue() {
     std::function<std::unique_ptr<ValueViewer<MapIndexType>>(int)> makeMapViewer;
     std::function<std::unique_ptr<ValueViewer<ListIndexType>>(int)> makeListViewer;
@@ -2085,44 +7595,578 @@ int testGenericValue() {
         return std::make_unique<decay_t<decltype(lambda)>>(std::move(lambda));
     };
     
-    // Map & ListViewer are stored as abstract ValueViewer, using the dynamic interface to break cyclic dependency.
-    // Using the fully templated handle calls is possible by creating explict functions
-    auto mapViewer = makeMapViewer(0);
-    auto listViewer = makeListViewer(0);
+    // Map & ListViewer are stored as abstract ValueViewer, using the dynamic interface to break cyclic dependency.
+    // Using the fully templated handle calls is possible by creating explict functions
+    auto mapViewer = makeMapViewer(0);
+    auto listViewer = makeListViewer(0);
+    
+    Map m{ 
+        { {"a", 0.0f}  
+        , {"b", 1L}  
+        , {"c", "c-string"}  
+        , {"d", std::string("c++ string")} 
+        , {"e", std::make_shared<List<>>(List<>{
+            { "XX"
+            , 2
+            , "3"
+            , std::make_shared<Map<>>(Map<>{
+                { {"deep", "nested"}
+                , {"a", true}
+              }})
+            , std::make_shared<List<>>(List<>{
+                { 1
+                , "2"
+                , "three"
+                , std::make_shared<Map<>>(Map<>{
+                    { {"very deep", "nested"}
+                    , {"and so", "on"}
+                    , {"some data", std::vector<unsigned char>{1,2,3,4}}
+                  }})
+              }})
+            }})
+          }
+    }};
+    // Call templated interface, templated iterate call is hiding virtual methods of ViewableMapValue
+    m.iterate(*mapViewer.get());
+    
+    // Explicitly call dynamic interafces 
+    std::cout << std::endl << "Explicitly call dynamic interafces" << std::endl;
+    const ViewableMapValue& abstractM = (const ViewableMapValue&) m;
+    abstractM.iterate(*mapViewer.get());
+    
+    // Flat visitor, all handles with a single vptr
+    std::cout << std::endl << "Flat visitor" << std::endl;
+    auto flatViewer = freeVisitor<FlatValueViewer<MapIndexType>>(
+        [](MapIndexType k, const auto& v) -> bool {
+            std::cout << k << ": " << type_name<decltype(v)>() << std::endl;
+            return true;
+        });
+    iterateFlat(abstractM, flatViewer);
+    // Only use the scalar handles of the flat visitor
+    std::cout << std::endl << "Flat visitor viewed as ScalarValueViewer" << std::endl;
+    abstractM.iterate(flatVisitorView<ScalarValueViewer<MapIndexType>>(flatViewer));
+    
+    // Viewer with additional batch interface, runs of numbers are handled at once
+    std::cout << std::endl << "Batched list iteration" << std::endl;
+    List<> numbers{{1, 2, 3, 4.0, 5.0, "six", 7L, 8L}};
+    auto batchViewer = composedVisitor<VisitorGroup<ValueViewer<ListIndexType>, BatchValueViewer<ListIndexType>>>(
+        freeVisitor<ValueViewer<ListIndexType>>(
+            [](ListIndexType i, const auto& v) -> bool {
+                std::cout << "#" << i << ": " << type_name<decltype(v)>() << std::endl;
+                return true;
+            }),
+        freeVisitor<BatchValueViewer<ListIndexType>>(
+            [](ListIndexRange r, auto v) -> bool {
+                std::cout << "#" << r.first << " - #" << r.last - 1 << ": " << v.size << " x " << type_name<typename decltype(v)::type>() << std::endl;
+                return true;
+            })
+    );
+    ((const ViewableListValue&) numbers).iterate((ValueViewer<ListIndexType>&) batchViewer);
+    // A column is passed to the batch interface at once
+    std::cout << std::endl << "Column list" << std::endl;
+    ColumnList<double> series{0.5, 1.5, 2.5, 3.5};
+    ((const ViewableListValue&) series).iterate((ValueViewer<ListIndexType>&) batchViewer);
+    series.iterate(*listViewer.get());
+    
+    // Lookup with a std::string_view, e.g. a slice of a parsed buffer. No std::string is constructed.
+    std::cout << std::endl << "Lookup by std::string_view" << std::endl;
+    std::string_view request = "d=?";
+    m.visit(request.substr(0, 1), flatViewer);
+    // Same through the abstract interface
+    static_cast<const ViewableMapValue&>(m).visit(request.substr(0, 1), *mapViewer.get());
+    
+    // Document with all nodes in one arena, children are referenced by plain pointers
+    std::cout << std::endl << "Document with arena allocated nodes" << std::endl;
+    Document doc;
+    doc.setRoot(doc.createMap(
+        { {"name", "config"}
+        , {"limits", doc.createList({1, 2.5, "unbounded"})}
+        , {"nested", doc.createMap({{"enabled", true}})}
+        }));
+    doc.root().iterate(*mapViewer.get());
+    
+    // Compact 16 byte cells instead of GenericValueHolder, short strings are passed as const char*
+    std::cout << std::dec << std::endl << "Compact values (" << sizeof(CompactValue) << " instead of " << sizeof(GenericValueHolder) << " bytes)" << std::endl;
+    List<CompactValue> compact{{1, 2.5f, "c-string", std::string("short"), std::string("a string with more than 14 characters"), std::vector<unsigned char>{5, 6}
+        , std::make_shared<Map<CompactValue>>(Map<CompactValue>{{ {"nested", true} }})}};
+    compact.iterate(*listViewer.get());
+    
+    
+    // One viewer for all depths, the position is passed as context
+    std::cout << std::endl << "Recursive viewer" << std::endl;
+    auto pathPrinter = recursiveViewer([](const TraversalContext& context, const auto& v) -> bool {
+        using T = decay_t<decltype(v)>;
+        std::cout << depthString(context.depth()) << context;
+        if constexpr (std::is_arithmetic_v<T> || std::is_convertible_v<T, std::string_view>) {
+            std::cout << " = " << v;
+        }
+        std::cout << std::endl;
+        return true;
+    });
+    pathPrinter.traverse(m);
+    
+    // Paths are parsed and hashed once, resolving them only visits the last value
+    std::cout << std::endl << "Compiled paths" << std::endl;
+    const CompiledPath deepPath("e[4][3].very deep");
+    deepPath.resolve(m, *mapViewer.get());
+    CompiledPath("e[3].deep").resolve(m, flatViewer);
+    CompiledPath("e[4][1]").resolve(m, *listViewer.get());
+    std::cout << "Missing: " << (CompiledPath("e[9].deep").resolve(m, *mapViewer.get()) ? "found" : "not found") << std::endl;
+    const CompiledPath invalidPath("e[x]");
+    std::cout << "Invalid path: " << invalidPath.error() << std::endl;
+    // All paths printed by the traversal resolve to their values
+    auto allPaths = recursiveViewer(PathCollector{});
+    allPaths.traverse(m);
+    size_t resolved = 0;
+    auto countMap = freeVisitor<ValueViewer<MapIndexType>>([&resolved](MapIndexType, const auto&) { ++resolved; return true; });
+    auto countList = freeVisitor<ValueViewer<ListIndexType>>([&resolved](ListIndexType, const auto&) { ++resolved; return true; });
+    for(const auto& text: allPaths.handler().paths) {
+        const CompiledPath path(text);
+        if(path.steps().back().isIndex()) path.resolve(m, countList);
+        else path.resolve(m, countMap);
+    }
+    std::cout << std::dec << resolved << " of " << allPaths.handler().paths.size() << " traversal paths resolved" << std::endl;
+    
+    // Sections of a reloaded configuration are compared by their fingerprints, the order of map entries does not matter
+    std::cout << std::endl << "Fingerprints" << std::endl;
+    std::optional<GenericValueHolder> oldConfig;
+    std::optional<GenericValueHolder> newConfig;
+    readJson(R"({"server": {"port": 80, "hosts": ["a", "b"]}, "limits": [1, 2, 3], "logging": {"level": "info"}})", oldConfig);
+    readJson(R"({"logging": {"level": "debug"}, "limits": [1, 2, 3], "server": {"hosts": ["a", "b"], "port": 80}})", newConfig);
+    const ViewableMapValue& oldRoot = *std::get<std::shared_ptr<ViewableMapValue>>(*oldConfig);
+    const ViewableMapValue& newRoot = *std::get<std::shared_ptr<ViewableMapValue>>(*newConfig);
+    std::cout << "Same configuration: " << (sameStructure(oldRoot, newRoot) ? "yes" : "no") << std::endl;
+    auto sectionViewer = freeVisitor<ValueViewer<MapIndexType>>([&oldRoot](MapIndexType k, const auto& v) -> bool {
+        uint64_t previous = 0;
+        auto previousViewer = freeVisitor<ValueViewer<MapIndexType>>([&previous](MapIndexType, const auto& old) -> bool {
+            previous = valueFingerprint(old);
+            return true;
+        });
+        oldRoot.visit(k, previousViewer);
+        std::cout << k << ": " << (previous == valueFingerprint(v) ? "unchanged" : "changed") << std::endl;
+        return true;
+    });
+    newRoot.iterate(sectionViewer);
+    
+    // Only the changed subtrees are traversed, the old tree is patched in place
+    std::cout << std::endl << "Diff and patch" << std::endl;
+    std::optional<GenericValueHolder> before;
+    std::optional<GenericValueHolder> after;
+    readJson(R"({"server": {"port": 80, "hosts": ["a", "b", "c"]}, "mode": 1, "obsolete": true, 
+                 "rules": [{"id": 1, "allow": true}, {"id": 2, "allow": true}, "default"]})", before);
+    readJson(R"({"server": {"port": 8080, "hosts": ["a", "c", "d", "e"]}, "mode": "fast", "feature": "on", 
+                 "rules": [{"id": 1, "allow": true}, {"id": 2, "allow": false}, "default"]})", after);
+    Map<>& beforeRoot = static_cast<Map<>&>(*std::get<std::shared_ptr<ViewableMapValue>>(*before));
+    const ViewableMapValue& afterRoot = *std::get<std::shared_ptr<ViewableMapValue>>(*after);
+    ChangeSet<> changes = diffTrees(beforeRoot, afterRoot);
+    for(const auto& change: changes) {
+        std::cout << change.kind << ": " << change.path;
+        if(change.kind == ChangeKind::RangeChanged) {
+            std::cout << " [" << change.first << ", " << change.last << ") by " << change.values.size() << " values";
+        }
+        std::cout << std::endl;
+    }
+    const bool patched = patchTree(beforeRoot, std::move(changes));
+    std::cout << "Patched: " << (patched && sameStructure<ViewableMapValue>(beforeRoot, afterRoot) ? "same as new version" : "different") << std::endl;
+    // New values which the variant of the change set cannot hold leave their change incomplete
+    using NumberValue = std::variant<long, double, std::shared_ptr<ViewableMapValue>, std::shared_ptr<ViewableListValue>>;
+    const Map<> numbersBefore{{ {"values", std::make_shared<List<>>(List<>{1L, 2L})} }};
+    const Map<> numbersAfter{{ {"values", std::make_shared<List<>>(List<>{1L, std::string("two"), 2L})} }};
+    for(const auto& change: diffTrees<NumberValue>(numbersBefore, numbersAfter)) {
+        std::cout << change.kind << ": " << change.path << (change.complete ? "" : " is incomplete") << std::endl;
+    }
+    
+    // Random pairs of trees which share most of their structure, the first one is patched into the second
+    struct RandomTree {
+        uint64_t state;
+        uint64_t mutations;
+        
+        uint64_t next(uint64_t bound) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state % bound;
+        }
+        // Occasionally consumes one more number, the rest of the tree differs from the tree built without mutations
+        bool mutate() {
+            return mutations != 0 && next(mutations) == 0;
+        }
+        GenericValueHolder value(int depth) {
+            switch(next(depth > 2 ? 4 : 6) + (mutate() ? 1 : 0)) {
+                case 0: return (long) next(5);
+                case 1: return next(4) * 0.5;
+                case 2: return std::string(next(3), 'x');
+                case 3: return next(2) == 0;
+                case 4: return std::shared_ptr<ViewableMapValue>(std::make_shared<Map<>>(map(depth + 1)));
+                default: {
+                    std::vector<GenericValueHolder> elements(next(6));
+                    for(auto& element: elements) element = value(depth + 1);
+                    return std::shared_ptr<ViewableListValue>(std::make_shared<List<>>(elements.begin(), elements.end()));
+                }
+            }
+        }
+        Map<> map(int depth) {
+            std::vector<std::pair<std::string, GenericValueHolder>> entries;
+            for(int key = 0; key < 5; ++key) {
+                if(next(3) != 0 && !mutate()) entries.emplace_back("k" + std::to_string(key), value(depth));
+            }
+            return Map<>(entries.begin(), entries.end());
+        }
+    };
+    size_t roundTrips = 0;
+    size_t randomChanges = 0;
+    const size_t randomTrees = 200;
+    for(uint64_t seed = 1; seed <= randomTrees; ++seed) {
+        Map<> from = RandomTree{seed * 0x9E3779B97F4A7C15ull, 0}.map(0);
+        const Map<> to = RandomTree{seed * 0x9E3779B97F4A7C15ull, 8}.map(0);
+        // Cached fingerprints of the patched tree have to match the ones of a fresh copy
+        ChangeSet<> randomChangeSet = diffTrees(from, to);
+        randomChanges += randomChangeSet.size();
+        if(patchTree(from, std::move(randomChangeSet)) && sameStructure(from, to)) {
+            const auto copy = copyValue(static_cast<const ViewableMapValue&>(from));
+            if(copy && std::get<std::shared_ptr<ViewableMapValue>>(*copy)->fingerprint() == from.fingerprint()) ++roundTrips;
+        }
+    }
+    std::cout << "Random trees patched: " << roundTrips << " of " << randomTrees << " by " << randomChanges << " changes" << std::endl;
+    
+    // Values are changed in place by editors, arrays grow and nested containers are edited through their editable interface
+    std::cout << std::endl << "Editing in place" << std::endl;
+    Map<> settings{{ {"retries", 3L}, {"ratio", 0.5}, {"name", std::string("short")}, {"weights", std::vector<double>{1, 2}}
+                   , {"limits", std::make_shared<List<>>(List<>{10L, 20L})} }};
+    const uint64_t fingerprintBeforeEdit = structuralFingerprint(settings);
+    auto doubler = freeVisitor<FlatValueEditor<ListIndexType>>([](ListIndexType, auto& v) {
+        using T = decay_t<decltype(v)>;
+        if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) v *= 2;
+        return true;
+    });
+    auto editor = freeVisitor<FlatValueEditor<MapIndexType>>([&doubler](MapIndexType, auto& v) {
+        using T = decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, long>) v += 1;
+        else if constexpr (std::is_same_v<T, std::string>) v += " and longer";
+        else if constexpr (std::is_same_v<T, std::vector<double>>) v.push_back(3);
+        else if constexpr (std::is_same_v<T, EditableListValue>) v.iterate(doubler);
+        return true;
+    });
+    settings.iterate(editor);
+    Value<> scalar(1.5);
+    scalar.editable().visit(freeVisitor<FlatValueEditor<void>>([](auto& v) {
+        if constexpr (std::is_same_v<decay_t<decltype(v)>, double>) v = -v;
+    }));
+    std::cout << writeJson(settings) << std::endl;
+    scalar.flat().visit(freeVisitor<FlatValueViewer<void>>([](const auto& v) {
+        if constexpr (std::is_same_v<decay_t<decltype(v)>, double>) std::cout << "Negated value: " << v << std::endl;
+    }));
+    std::cout << "Structure changed: " << (structuralFingerprint(settings) != fingerprintBeforeEdit ? "yes" : "no") << std::endl;
+    // Changes of nested containers reached through other references are seen by the cached fingerprints of the ancestors
+    auto makeNested = []() {
+        auto grandchild = std::make_shared<Map<>>(Map<>{{ {"level", 2L} }});
+        auto child = std::make_shared<List<>>(List<>{{ std::shared_ptr<ViewableMapValue>(grandchild) }});
+        return std::make_pair(Map<>{{ {"child", std::shared_ptr<ViewableListValue>(child)} }}, grandchild);
+    };
+    auto [nested, nestedGrandchild] = makeNested();
+    auto [equalNested, equalGrandchild] = makeNested();
+    const Map<> shallowCopy(nested);
+    const uint64_t rootBeforeEdit = nested.fingerprint();
+    std::cout << "Equal before: " << (sameStructure(nested, equalNested) ? "yes" : "no");
+    nestedGrandchild->editable()->iterate(freeVisitor<FlatValueEditor<MapIndexType>>([](MapIndexType, auto& v) {
+        if constexpr (std::is_same_v<decay_t<decltype(v)>, long>) v = 3;
+        return true;
+    }));
+    std::cout << ", root changed after editing the grandchild: " << (nested.fingerprint() != rootBeforeEdit ? "yes" : "no")
+              << ", equal to the unchanged tree: " << (sameStructure(nested, equalNested) ? "yes" : "no")
+              << ", equal to its shallow copy: " << (sameStructure(nested, shallowCopy) ? "yes" : "no") << std::endl;
+    
+    // Rows are moved into the tree, names and readings are not copied
+    std::cout << std::endl << "Builders" << std::endl;
+    struct Row {
+        long id;
+        std::string name;
+        std::vector<double> readings;
+    };
+    std::vector<Row> rows{{1, "first sensor of the hall", {0.5, 1.5}}, {2, "second sensor of the hall", {2.5}}};
+    List<> table = ListBuilder<>(rows.size()).generate(rows.size(), [&rows](size_t i) {
+        Row& row = rows[i];
+        return MapBuilder<>(3).emplace("id", row.id).emplace("name", std::move(row.name)).emplace("readings", std::move(row.readings)).buildShared();
+    }).build();
+    std::cout << writeJson(table) << std::endl;
+    std::cout << "Readings left in the rows: " << rows[0].readings.size() + rows[1].readings.size() << std::endl;
+    
+    // A received buffer is adopted by the tree and released by its callback when the last copy is dropped
+    std::cout << std::endl << "External arrays" << std::endl;
+    {
+        const size_t sampleCount = 1000;
+        double* received = static_cast<double*>(std::malloc(sampleCount * sizeof(double)));
+        for(size_t i = 0; i < sampleCount; ++i) {
+            received[i] = 0.001 * i;
+        }
+        Map<> frame{{ {"sensor", 7L}, {"samples", ExternalArray<double>(received, sampleCount, [](const double* data, size_t size) {
+            std::free(const_cast<double*>(data));
+            std::cout << "Released " << size << " samples" << std::endl;
+        })} }};
+        auto sumViewer = freeVisitor<FloatingContiguousValueViewer<MapIndexType>>([received](MapIndexType k, auto v) {
+            double sum = 0;
+            for(size_t i = 0; i < v.size; ++i) sum += v.data[i];
+            std::cout << k << ": " << v.size << " values at the received address: " << (static_cast<const void*>(v.data) == received ? "yes" : "no") << ", sum " << sum << std::endl;
+            return true;
+        });
+        frame.visit("samples", sumViewer);
+        auto copy = std::make_shared<Map<>>(frame);
+        std::cout << "Copied frame" << std::endl;
+    }
+    
+    // Statistics of a list computed on all cores, each worker has its own copy of the viewer
+    std::cout << std::endl << "Parallel iteration" << std::endl;
+    std::vector<GenericValueHolder> samples;
+    for(long i = 0; i < 100000; ++i) {
+        samples.emplace_back(i % 2 == 0 ? GenericValueHolder(i) : GenericValueHolder(0.5 * i));
+    }
+    List<> sampleList(samples.begin(), samples.end());
+    ThreadPool pool(4);
+    auto statistics = freeVisitor<ScalarValueViewer<ListIndexType>>(NumberStatistics{});
+    parallelIterate(pool, sampleList, statistics, [](auto& result, const auto& clone) {
+        result.sum += clone.sum;
+        result.count += clone.count;
+    });
+    const auto precision = std::cout.precision();
+    std::cout << std::dec << statistics.count << " numbers, sum " << std::fixed << std::setprecision(1) << statistics.sum << std::defaultfloat << std::setprecision(precision) << std::endl;
+    // Callers outside of the pool iterating at the same time
+    std::atomic<bool> allCounted{true};
+    std::vector<std::thread> callers;
+    for(int c = 0; c < 3; ++c) {
+        callers.emplace_back([&pool, &sampleList, &allCounted] {
+            auto counter = freeVisitor<ScalarValueViewer<ListIndexType>>(NumberStatistics{});
+            parallelIterate(pool, sampleList, counter, [](auto& result, const auto& clone) {
+                result.count += clone.count;
+            }, 1024);
+            if(counter.count != sampleList.size()) allCounted = false;
+        });
+    }
+    for(auto& caller: callers) {
+        caller.join();
+    }
+    std::cout << "Concurrent callers counted all numbers: " << (allCounted ? "yes" : "no") << std::endl;
+    // A throwing task does not stop the others, wait rethrows the exception
+    {
+        TaskGroup group(pool);
+        std::atomic<int> finished{0};
+        for(int t = 0; t < 8; ++t) {
+            group.spawn([&finished, t] {
+                if(t == 3) throw std::runtime_error("task 3 failed");
+                ++finished;
+            });
+        }
+        try {
+            group.wait();
+        }
+        catch(const std::exception& e) {
+            std::cout << "Rethrown by wait: " << e.what() << ", other tasks finished: " << finished << std::endl;
+        }
+    }
+    
+    // Nested containers are traversed as tasks, the results are combined in document order
+    std::cout << std::endl << "Parallel traversal" << std::endl;
+    auto appendPaths = [](PathCollector& into, const PathCollector& from) {
+        into.paths.insert(into.paths.end(), from.paths.begin(), from.paths.end());
+    };
+    PathCollector parallelPaths = parallelTraverse(pool, m, PathCollector{}, appendPaths, 1);
+    auto sequentialPaths = recursiveViewer(PathCollector{});
+    sequentialPaths.traverse(m);
+    for(const auto& path: parallelPaths.paths) {
+        std::cout << path << " ";
+    }
+    std::cout << std::endl << "Same order as sequential traversal: " << (parallelPaths.paths == sequentialPaths.handler().paths ? "yes" : "no") << std::endl;
+    
+    // Readers visit a snapshot without locks while new versions are published
+    std::cout << std::endl << "Snapshot map" << std::endl;
+    SnapshotMap<> config(Map<>{{ {"version", 1L}, {"name", "initial"} }});
+    std::atomic<bool> reloading{true};
+    std::atomic<bool> ordered{true};
+    std::vector<std::thread> readers;
+    for(int r = 0; r < 2; ++r) {
+        readers.emplace_back([&config, &reloading, &ordered] {
+            long lastVersion = 0;
+            auto versionViewer = freeVisitor<ScalarValueViewer<MapIndexType>>([&](MapIndexType, auto v) -> bool {
+                if constexpr (std::is_same_v<decltype(v), long>) {
+                    if(v < lastVersion) ordered = false;
+                    lastVersion = v;
+                }
+                return true;
+            });
+            while(reloading) {
+                config.visit("version", versionViewer);
+            }
+        });
+    }
+    for(long version = 2; version <= 100; ++version) {
+        config.publish(Map<>{{ {"version", version}, {"name", "reloaded"} }});
+    }
+    reloading = false;
+    for(auto& reader: readers) {
+        reader.join();
+    }
+    config.iterate(*mapViewer.get());
+    std::cout << "Versions seen in order: " << (ordered ? "yes" : "no") << ", retired versions left: " << config.retired() << std::endl;
+    
+    // Two cursors advanced alternately, merge join of sorted lists
+    std::cout << std::endl << "Cursor merge join" << std::endl;
+    List<> left{{1L, 3L, 5L, 7L}};
+    List<> right{{2L, 3L, 6L}};
+    auto readLong = [](const auto& c) {
+        long value = 0;
+        c.get([&value](ListIndexType, const auto& v) -> bool {
+            if constexpr (std::is_same_v<decay_t<decltype(v)>, long>) value = v;
+            return true;
+        });
+        return value;
+    };
+    auto leftCursor = cursor(left);
+    auto rightCursor = cursor(right);
+    while(!leftCursor.done() || !rightCursor.done()) {
+        if(rightCursor.done() || (!leftCursor.done() && readLong(leftCursor) <= readLong(rightCursor))) {
+            std::cout << readLong(leftCursor) << " ";
+            ++leftCursor;
+        }
+        else {
+            std::cout << readLong(rightCursor) << " ";
+            ++rightCursor;
+        }
+    }
+    std::cout << std::endl;
+    
+    // A page is a stored position
+    std::cout << std::endl << "Cursor page 2 (page size 3)" << std::endl;
+    for(auto page = cursor(sampleList, 3); !page.done() && page.position() < 6; ++page) {
+        page.visit(*listViewer.get());
+    }
+    // Positions past the end are not read, ranges are clamped
+    auto stale = cursor(left);
+    stale.seek(left.size() + 5);
+    std::cout << "Visit past the end: " << (stale.visit(*listViewer.get()) ? "called" : "false") << std::endl;
+    left.iterateRange(2, 100, *listViewer.get());
+#if defined(__cpp_impl_coroutine) && defined(__cpp_lib_coroutine)
     
-    Map m{ 
-        { {"a", 0.0f}  
-        , {"b", 1L}  
-        , {"c", "c-string"}  
-        , {"d", std::string("c++ string")} 
-        , {"e", std::make_shared<List<>>(List<>{
-            { "XX"
-            , 2
-            , "3"
-            , std::make_shared<Map<>>(Map<>{
-                { {"deep", "nested"}
-                , {"a", true}
-              }})
-            , std::make_shared<List<>>(List<>{
-                { 1
-                , "2"
-                , "three"
-                , std::make_shared<Map<>>(Map<>{
-                    { {"very deep", "nested"}
-                    , {"and so", "on"}
-                    , {"some data", std::vector<unsigned char>{1,2,3,4}}
-                  }})
-              }})
-            }})
-          }
-    }};
-    // Call templated interface, templated iterate call is hiding virtual methods of ViewableMapValue
-    m.iterate(*mapViewer.get());
+    std::cout << std::endl << "Generator" << std::endl;
+    for(const auto& [i, v]: elements(left, 2)) {
+        std::cout << "#" << i << ": " << std::get<long>(v) << std::endl;
+    }
+#endif
     
-    // Explicitly call dynamic interafces 
-    std::cout << std::endl << "Explicitly call dynamic interafces" << std::endl;
-    const ViewableMapValue& abstractM = (const ViewableMapValue&) m;
-    abstractM.iterate(*mapViewer.get());
+    // Keys and strings without escapes are copied directly from the input
+    std::cout << std::endl << "JSON" << std::endl;
+    std::optional<GenericValueHolder> json;
+    std::string jsonError;
+    if(readJson(R"({"name": "sensor \u00b5 \ud83d\ude00", "ids": [1, 2, 3], "scale": [0.5, 2], "active": true, "unit": null,
+                    "points": [{"x": 1.5, "y": -2e3}, "origin"]})", json, &jsonError)) {
+        std::get<std::shared_ptr<ViewableMapValue>>(*json)->iterate(*mapViewer.get());
+    }
+    if(!readJson("[1, 2,]", json, &jsonError)) {
+        std::cout << "Invalid JSON: " << jsonError << std::endl;
+    }
+    // Inputs outside of RFC 8259 are rejected
+    for(std::string_view invalid: {std::string_view("[01]"), std::string_view("[1.]"), std::string_view("[.5]"), std::string_view("[1e+]"), 
+            std::string_view(R"(["\ud800"])"), std::string_view(R"(["\ud800\u0041"])"), std::string_view(R"(["\udc00"])"), 
+            std::string_view("[\"tab\t\"]"), std::string_view("[\"nul\0\"]", 8), std::string_view(R"({"a": 1, "a": 2})")}) {
+        jsonError.clear();
+        readJson(invalid, json, &jsonError);
+        std::cout << "Rejected: " << (jsonError.empty() ? "no" : jsonError) << std::endl;
+    }
+    
+    // Binary data is written as base64 string, hence it is read back as string
+    std::cout << std::endl << "JSON writer" << std::endl;
+    const std::string written = writeJson(m);
+    std::cout << written << std::endl;
+    if(readJson(written, json)) {
+        const bool same = writeJson(*std::get<std::shared_ptr<ViewableMapValue>>(*json)) == written;
+        std::cout << "Read back and written again: " << (same ? "same" : "different") << std::endl;
+    }
+    
+    // The document is mapped and read in place, only the map keys are copied
+    std::cout << std::endl << "Binary document" << std::endl;
+    const std::string encoded = encodeBinary(m);
+    const char* documentPath = "example_document.cvpb";
+    if(std::FILE* file = std::fopen(documentPath, "wb")) {
+        std::fwrite(encoded.data(), 1, encoded.size(), file);
+        std::fclose(file);
+    }
+    {
+        BinaryDocument document;
+        if(document.open(documentPath)) {
+            std::cout << "Mapped " << std::dec << document.bytes().size() << " bytes" << std::endl;
+            document.rootMap()->iterate(*mapViewer.get());
+            std::cout << "Lookup of d: ";
+            document.rootMap()->visit("d", *mapViewer.get());
+            std::cout << "Same JSON as the source: " << (writeJson(*document.rootMap()) == written ? "yes" : "no") << std::endl;
+        }
+    }
+    std::remove(documentPath);
+    // Lookups are binary searches, a document with an unsorted map index is rejected
+    {
+        std::vector<uint64_t> tampered((encoded.size() + 7) / 8);
+        std::memcpy(tampered.data(), encoded.data(), encoded.size());
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(tampered.data());
+        BinaryHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        uint64_t index;
+        std::memcpy(&index, bytes + header.root.payload + sizeof(uint64_t), sizeof(index));
+        std::swap_ranges(bytes + index, bytes + index + sizeof(uint32_t), bytes + index + sizeof(uint32_t));
+        BinaryDocument document;
+        std::cout << "Unsorted index loaded: " << (document.load(std::string_view(reinterpret_cast<const char*>(bytes), encoded.size())) ? "yes" : "no") << std::endl;
+    }
+    // Corrupt node counts are rejected before anything is reserved for them
+    {
+        std::vector<uint64_t> corrupt((encoded.size() + 7) / 8);
+        std::memcpy(corrupt.data(), encoded.data(), encoded.size());
+        BinaryHeader header;
+        std::memcpy(&header, corrupt.data(), sizeof(header));
+        header.maps = ~uint64_t(0);
+        header.lists = 1;
+        std::memcpy(corrupt.data(), &header, sizeof(header));
+        BinaryDocument document;
+        std::cout << "Header with 2^64 - 1 maps loaded: " << (document.load(std::string_view(reinterpret_cast<const char*>(corrupt.data()), encoded.size())) ? "yes" : "no") << std::endl;
+    }
+    
+    // Only the values reached by visit are decoded
+    std::cout << std::endl << "Lazy JSON" << std::endl;
+    const std::string lazyText = R"({"config": {"name": "lazy", "limits": [10, 20, 30]}, "records": [{"id": 1}, {"id": 2}, {"id": 3}], "note": "tab\tand \"quotes\"", 
+                                     "key\twith escape": 1, "\u00b5 key": 2, "key \"quoted\"": 3})";
+    std::optional<GenericValueHolder> lazy;
+    if(readJsonLazy(lazyText, lazy)) {
+        const auto& lazyRoot = static_cast<const LazyJsonMap<>&>(*std::get<std::shared_ptr<ViewableMapValue>>(*lazy));
+        lazyRoot.visit("config", *mapViewer.get());
+        std::cout << "Decoded " << std::dec << lazyRoot.decoded() << " of " << lazyRoot.size() << " values" << std::endl;
+        lazyRoot.iterate(*mapViewer.get());
+        std::cout << "Decoded " << lazyRoot.decoded() << " of " << lazyRoot.size() << " values" << std::endl;
+    }
+    
+    // Typed arrays and binary data keep their types, unlike in JSON
+    std::cout << std::endl << "MessagePack" << std::endl;
+    const std::string packed = writeMsgPack(m);
+    std::cout << std::dec << packed.size() << " bytes against " << written.size() << " bytes of JSON" << std::endl;
+    std::optional<GenericValueHolder> unpacked;
+    std::string packedError;
+    if(readMsgPack(packed, unpacked, &packedError)) {
+        std::cout << "Same JSON as the source: " << (writeJson(*std::get<std::shared_ptr<ViewableMapValue>>(*unpacked)) == written ? "yes" : "no") << std::endl;
+    }
+    if(!readMsgPack(packed.substr(0, packed.size() - 1), unpacked, &packedError)) {
+        std::cout << "Invalid MessagePack: " << packedError << std::endl;
+    }
+    // A shared input is adopted: bin data is passed in place, typed arrays if they need no conversion
+    const auto sharedPacked = std::make_shared<const std::string>(writeMsgPack(Map<>{{ {"bytes", std::vector<unsigned char>{1, 2, 3}}, {"values", std::vector<double>{0.5, 1.5}} }}));
+    if(readMsgPack(sharedPacked, unpacked)) {
+        auto arrayViewer = freeVisitor<ContiguousValueViewer<MapIndexType>>([&sharedPacked](MapIndexType k, auto v) -> bool {
+            const bool inInput = static_cast<const void*>(v.data) >= static_cast<const void*>(sharedPacked->data()) 
+                && static_cast<const void*>(v.data) < static_cast<const void*>(sharedPacked->data() + sharedPacked->size());
+            std::cout << k << ": " << v.size << " values " << (inInput ? "in the input" : "converted") << std::endl;
+            return true;
+        });
+        std::get<std::shared_ptr<ViewableMapValue>>(*unpacked)->iterate(static_cast<ContiguousValueViewer<MapIndexType>&>(arrayViewer));
+    }
+    
+    std::cout << std::endl << "Text writer" << std::endl;
+    {
+        OutputBuffer out(stdout);
+        ValueWriter<>(out, WriteFormat::Text).write(m);
+    }
     
     
     // Lambad as visitor
@@ -2180,12 +8224,1160 @@ int testGenericValue() {
     return 0;
 };
 
+
+//-----------------------------------------------------------------------------
+// Benchmark: dispatch cost of the different access paths
+//
+// The same workloads (scalar reads, Map::iterate, List::iterate, nested traversal) are run
+//  - virtual:   through the abstract interfaces (ViewableValue, ViewableMapValue, ViewableListValue)
+//  - flat:      through the abstract interfaces with the single vptr FlatValueViewer
+//  - crtp:      through the templated visit/iterate of Value/Map/List (CRTPVisitable implementation)
+//  - std-visit: through std::visit on plain GenericValueHolder data
+//  - tag-switch: through an interface with getType() and getters (see header comment)
+//
+// Build and run with `make bench`. One op is one handled element (leaf).
+//-----------------------------------------------------------------------------
+#ifdef RUN_BENCHMARK
+#include <chrono>
+#include <cstdio>
+
+#ifndef BENCHMARK_MIN_TIME_MS
+#define BENCHMARK_MIN_TIME_MS 200
+#endif
+
+static volatile double benchmarkSink = 0;
+
+// Accumulates all numeric values handled, everything else is counted only
+struct BenchmarkAccumulator {
+    double sum = 0;
+    size_t count = 0;
+    
+    template<typename T>
+    void operator()(const T& v) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            sum += v;
+        }
+        ++count;
+    }
+};
+
+template<typename Func>
+void runBenchmark(const char* workload, const char* path, size_t opsPerRun, Func&& func) {
+    using Clock = std::chrono::steady_clock;
+    size_t runs = 0;
+    double result = 0;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        result += func();
+        ++runs;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(BENCHMARK_MIN_TIME_MS));
+    benchmarkSink = benchmarkSink + result;
+    
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    double nsPerOp = ns / (double(runs) * double(opsPerRun));
+    std::printf("%-10s %-11s %10.2f ns/op %14.0f calls/s\n", workload, path, nsPerOp, 1e9 / nsPerOp);
+}
+
+
+// --- Tag switch baseline ---
+// Interface with a type tag and one getter per type, as described in the header comment.
+enum class TaggedType { Long, SizeT, Int, Bool, Double, Float, String, List, Map };
+
+class TaggedValue {
+public:
+    virtual TaggedType getType() const = 0;
+    virtual long getLong() const = 0;
+    virtual size_t getSizeT() const = 0;
+    virtual int getInt() const = 0;
+    virtual bool getBool() const = 0;
+    virtual double getDouble() const = 0;
+    virtual float getFloat() const = 0;
+    virtual const std::string& getString() const = 0;
+    
+    // Containers
+    virtual size_t size() const = 0;
+    virtual const std::string& keyAt(size_t) const = 0;
+    virtual const TaggedValue& at(size_t) const = 0;
+    
+    virtual ~TaggedValue() =default;
+};
+
+class TaggedNode final: public TaggedValue {
+private:
+    TaggedType type_;
+    union {
+        long l_;
+        size_t u_;
+        int i_;
+        bool b_;
+        double d_;
+        float f_;
+    };
+    std::string s_;
+    std::vector<std::string> keys_;
+    std::vector<std::unique_ptr<TaggedNode>> children_;
+    
+public:
+    TaggedNode(long v): type_(TaggedType::Long), l_(v) {}
+    TaggedNode(size_t v): type_(TaggedType::SizeT), u_(v) {}
+    TaggedNode(int v): type_(TaggedType::Int), i_(v) {}
+    TaggedNode(bool v): type_(TaggedType::Bool), b_(v) {}
+    TaggedNode(double v): type_(TaggedType::Double), d_(v) {}
+    TaggedNode(float v): type_(TaggedType::Float), f_(v) {}
+    TaggedNode(std::string v): type_(TaggedType::String), l_(0), s_(std::move(v)) {}
+    explicit TaggedNode(TaggedType containerType): type_(containerType), l_(0) {}
+    
+    void append(std::unique_ptr<TaggedNode> n) { children_.push_back(std::move(n)); }
+    void insert(std::string k, std::unique_ptr<TaggedNode> n) { keys_.push_back(std::move(k)); children_.push_back(std::move(n)); }
+    
+    TaggedType getType() const override { return type_; }
+    long getLong() const override { return l_; }
+    size_t getSizeT() const override { return u_; }
+    int getInt() const override { return i_; }
+    bool getBool() const override { return b_; }
+    double getDouble() const override { return d_; }
+    float getFloat() const override { return f_; }
+    const std::string& getString() const override { return s_; }
+    
+    size_t size() const override { return children_.size(); }
+    const std::string& keyAt(size_t i) const override { return keys_[i]; }
+    const TaggedValue& at(size_t i) const override { return *children_[i]; }
+};
+
+inline void accumulateTagged(BenchmarkAccumulator& acc, const TaggedValue& v) {
+    switch(v.getType()) {
+        case TaggedType::Long:   acc(v.getLong());   break;
+        case TaggedType::SizeT:  acc(v.getSizeT());  break;
+        case TaggedType::Int:    acc(v.getInt());    break;
+        case TaggedType::Bool:   acc(v.getBool());   break;
+        case TaggedType::Double: acc(v.getDouble()); break;
+        case TaggedType::Float:  acc(v.getFloat());  break;
+        case TaggedType::String: acc(v.getString()); break;
+        case TaggedType::List: 
+        case TaggedType::Map: 
+            for(size_t i = 0; i < v.size(); ++i) {
+                accumulateTagged(acc, v.at(i));
+            }
+            break;
+    }
+}
+
+
+// --- Plain std::variant tree (no interfaces at all) ---
+struct RawNode {
+    std::variant<long, size_t, int, bool, double, float, std::string, std::vector<RawNode>, std::vector<std::pair<std::string, RawNode>>> val;
+};
+
+inline void accumulateRaw(BenchmarkAccumulator& acc, const RawNode& n) {
+    std::visit([&acc](const auto& v){
+        using T = decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::vector<RawNode>>) {
+            for(const auto& c: v) accumulateRaw(acc, c);
+        }
+        else if constexpr (std::is_same_v<T, std::vector<std::pair<std::string, RawNode>>>) {
+            for(const auto& c: v) accumulateRaw(acc, c.second);
+        }
+        else {
+            acc(v);
+        }
+    }, n.val);
+}
+
+
+// --- Workload data ---
+// Scalar i is of alternating numeric type
+template<typename F>
+inline void forBenchmarkScalar(size_t i, F&& f) {
+    switch(i % 6) {
+        case 0: f((long) i); break;
+        case 1: f((double) i); break;
+        case 2: f((int) i); break;
+        case 3: f((float) i); break;
+        case 4: f((size_t) i); break;
+        default: f((i % 2) == 0); break;
+    }
+}
+
+// Nested document: root map with sections, each containing an id, a weight and a list of small maps
+static const size_t benchmarkSections = 64;
+static const size_t benchmarkItems = 32;
+static const size_t benchmarkNestedLeaves = benchmarkSections * (2 + benchmarkItems * 4);
+
+// The same document is built for all paths
+struct BenchmarkDocument {
+    std::shared_ptr<Map<>> map;
+    RawNode raw;
+    std::unique_ptr<TaggedNode> tagged;
+};
+
+inline BenchmarkDocument makeBenchmarkDocument() {
+    BenchmarkDocument doc;
+    std::vector<std::pair<const std::string, GenericValueHolder>> sections;
+    std::vector<std::pair<std::string, RawNode>> rawSections;
+    doc.tagged = std::make_unique<TaggedNode>(TaggedType::Map);
+    
+    for(size_t s = 0; s < benchmarkSections; ++s) {
+        std::vector<GenericValueHolder> items;
+        std::vector<RawNode> rawItems;
+        auto taggedItems = std::make_unique<TaggedNode>(TaggedType::List);
+        for(size_t i = 0; i < benchmarkItems; ++i) {
+            items.emplace_back(std::make_shared<Map<>>(Map<>{
+                { {"a", (long) i}
+                , {"b", 0.5 * i}
+                , {"c", (int) s}
+                , {"d", (i % 2) == 0}
+              }}));
+            rawItems.push_back(RawNode{std::vector<std::pair<std::string, RawNode>>{
+                { {"a", RawNode{(long) i}}
+                , {"b", RawNode{0.5 * i}}
+                , {"c", RawNode{(int) s}}
+                , {"d", RawNode{(i % 2) == 0}}
+              }}});
+            auto taggedItem = std::make_unique<TaggedNode>(TaggedType::Map);
+            taggedItem->insert("a", std::make_unique<TaggedNode>((long) i));
+            taggedItem->insert("b", std::make_unique<TaggedNode>(0.5 * i));
+            taggedItem->insert("c", std::make_unique<TaggedNode>((int) s));
+            taggedItem->insert("d", std::make_unique<TaggedNode>((i % 2) == 0));
+            taggedItems->append(std::move(taggedItem));
+        }
+        
+        const std::string key = "s" + std::to_string(s);
+        sections.emplace_back(key, std::make_shared<Map<>>(Map<>{
+            { {"id", (long) s}
+            , {"weight", 1.0 / (s + 1)}
+            , {"items", std::make_shared<List<>>(items.begin(), items.end())}
+          }}));
+        rawSections.emplace_back(key, RawNode{std::vector<std::pair<std::string, RawNode>>{
+            { {"id", RawNode{(long) s}}
+            , {"weight", RawNode{1.0 / (s + 1)}}
+            , {"items", RawNode{std::move(rawItems)}}
+          }}});
+        auto taggedSection = std::make_unique<TaggedNode>(TaggedType::Map);
+        taggedSection->insert("id", std::make_unique<TaggedNode>((long) s));
+        taggedSection->insert("weight", std::make_unique<TaggedNode>(1.0 / (s + 1)));
+        taggedSection->insert("items", std::move(taggedItems));
+        doc.tagged->insert(key, std::move(taggedSection));
+    }
+    doc.map = std::make_shared<Map<>>(sections.begin(), sections.end());
+    doc.raw = RawNode{std::move(rawSections)};
+    return doc;
+}
+
+// Creates nodes of the benchmark tree with shared ownership, same interface as Document
+struct SharedNodeFactory {
+    std::shared_ptr<Map<>> createMap(std::initializer_list<std::pair<const std::string, GenericValueHolder>> l) {
+        return std::make_shared<Map<>>(l);
+    }
+    template<typename InputIt>
+    std::shared_ptr<Map<>> createMap(InputIt first, InputIt last) {
+        return std::make_shared<Map<>>(first, last);
+    }
+    template<typename InputIt>
+    std::shared_ptr<List<>> createList(InputIt first, InputIt last) {
+        return std::make_shared<List<>>(first, last);
+    }
+};
+
+// Number of Map/List nodes of the benchmark document
+static const size_t benchmarkNodes = 1 + benchmarkSections * (2 + benchmarkItems);
+
+// Builds the Map<> tree of makeBenchmarkDocument with a SharedNodeFactory or a Document, returns the root
+template<typename VariantType, typename Factory>
+auto makeBenchmarkTree(Factory& factory) {
+    std::vector<std::pair<const std::string, VariantType>> sections;
+    std::vector<VariantType> items;
+    for(size_t s = 0; s < benchmarkSections; ++s) {
+        items.clear();
+        for(size_t i = 0; i < benchmarkItems; ++i) {
+            items.emplace_back(factory.createMap(
+                { {"a", (long) i}
+                , {"b", 0.5 * i}
+                , {"c", (int) s}
+                , {"d", (i % 2) == 0}
+                }));
+        }
+        sections.emplace_back("s" + std::to_string(s), factory.createMap(
+            { {"id", (long) s}
+            , {"weight", 1.0 / (s + 1)}
+            , {"items", factory.createList(items.begin(), items.end())}
+            }));
+    }
+    return factory.createMap(sections.begin(), sections.end());
+}
+
+// Handler of parallelTraverse, accumulates all leaves
+struct BenchmarkTreeAccumulator {
+    BenchmarkAccumulator acc;
+    
+    template<typename T>
+    bool operator()(const TraversalContext&, const T& v) {
+        if constexpr (!std::is_base_of_v<ViewableMapValue, T> && !std::is_base_of_v<ViewableListValue, T>) {
+            acc(v);
+        }
+        return true;
+    }
+};
+
+// Visitors counting all leaves of a nested document, nested containers are iterated with the same visitors
+template<template<typename IndexType> class TViewer, typename Func>
+void withNestedBenchmarkViewers(Func&& func) {
+    BenchmarkAccumulator acc;
+    TViewer<MapIndexType>* mapViewerPtr = nullptr;
+    TViewer<ListIndexType>* listViewerPtr = nullptr;
+    auto onValue = [&acc, &mapViewerPtr, &listViewerPtr](const auto& v) -> bool {
+        using T = decay_t<decltype(v)>;
+        constexpr bool flat = std::is_same_v<TViewer<MapIndexType>, FlatValueViewer<MapIndexType>>;
+        if constexpr (std::is_base_of_v<ViewableMapValue, T>) {
+            if constexpr (flat) iterateFlat(v, *mapViewerPtr);
+            else v.iterate(*mapViewerPtr);
+        }
+        else if constexpr (std::is_base_of_v<ViewableListValue, T>) {
+            if constexpr (flat) iterateFlat(v, *listViewerPtr);
+            else v.iterate(*listViewerPtr);
+        }
+        else {
+            acc(v);
+        }
+        return true;
+    };
+    auto mapViewer = freeVisitor<TViewer<MapIndexType>>([&onValue](MapIndexType, const auto& v){ return onValue(v); });
+    auto listViewer = freeVisitor<TViewer<ListIndexType>>([&onValue](ListIndexType, const auto& v){ return onValue(v); });
+    mapViewerPtr = &mapViewer;
+    listViewerPtr = &listViewer;
+    func(acc, mapViewer);
+}
+
+inline int runBenchmarks() {
+    const size_t scalarCount = 1 << 16;
+    const size_t mapCount = 1 << 12;
+    const size_t listCount = 1 << 16;
+    
+    std::printf("%-10s %-11s %16s %22s\n", "workload", "path", "time", "throughput");
+    
+    // --- Scalar reads ---
+    {
+        std::vector<Value<>> values;
+        std::vector<GenericValueHolder> raw;
+        std::vector<std::unique_ptr<TaggedValue>> tagged;
+        values.reserve(scalarCount);
+        for(size_t i = 0; i < scalarCount; ++i) {
+            forBenchmarkScalar(i, [&](auto v){
+                values.emplace_back(v);
+                raw.emplace_back(v);
+                tagged.push_back(std::make_unique<TaggedNode>(v));
+            });
+        }
+        
+        runBenchmark("scalar", "virtual", scalarCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<void>>([&acc](const auto& v){ acc(v); });
+            for(const auto& v: values) {
+                ((const ViewableValue&) v).visit((ValueViewer<void>&) viewer);
+            }
+            return acc.sum;
+        });
+        runBenchmark("scalar", "flat", scalarCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<FlatValueViewer<void>>([&acc](const auto& v){ acc(v); });
+            for(const auto& v: values) {
+                v.flat().visit(viewer);
+            }
+            return acc.sum;
+        });
+        runBenchmark("scalar", "crtp", scalarCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<void>>([&acc](const auto& v){ acc(v); });
+            for(const auto& v: values) {
+                v.visit(viewer);
+            }
+            return acc.sum;
+        });
+        runBenchmark("scalar", "std-visit", scalarCount, [&]() {
+            BenchmarkAccumulator acc;
+            for(const auto& v: raw) {
+                std::visit([&acc](const auto& v){
+                    if constexpr (std::is_arithmetic_v<decay_t<decltype(v)>>) acc(v);
+                }, v);
+            }
+            return acc.sum;
+        });
+        runBenchmark("scalar", "tag-switch", scalarCount, [&]() {
+            BenchmarkAccumulator acc;
+            for(const auto& v: tagged) {
+                accumulateTagged(acc, *v);
+            }
+            return acc.sum;
+        });
+    }
+    
+    // --- Map::iterate ---
+    {
+        std::vector<std::pair<const std::string, GenericValueHolder>> entries;
+        std::unordered_map<std::string, GenericValueHolder> raw;
+        TaggedNode tagged(TaggedType::Map);
+        for(size_t i = 0; i < mapCount; ++i) {
+            const std::string key = "key" + std::to_string(i);
+            forBenchmarkScalar(i, [&](auto v){
+                entries.emplace_back(key, v);
+                raw.emplace(key, v);
+                tagged.insert(key, std::make_unique<TaggedNode>(v));
+            });
+        }
+        Map<> map(entries.begin(), entries.end());
+        
+        runBenchmark("map", "virtual", mapCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            ((const ViewableMapValue&) map).iterate((ValueViewer<MapIndexType>&) viewer);
+            return acc.sum;
+        });
+        runBenchmark("map", "flat", mapCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<FlatValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            iterateFlat((const ViewableMapValue&) map, viewer);
+            return acc.sum;
+        });
+        runBenchmark("map", "crtp", mapCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            map.iterate(viewer);
+            return acc.sum;
+        });
+        runBenchmark("map", "std-visit", mapCount, [&]() {
+            BenchmarkAccumulator acc;
+            for(const auto& p: raw) {
+                std::visit([&acc](const auto& v){
+                    if constexpr (std::is_arithmetic_v<decay_t<decltype(v)>>) acc(v);
+                }, p.second);
+            }
+            return acc.sum;
+        });
+        runBenchmark("map", "tag-switch", mapCount, [&]() {
+            BenchmarkAccumulator acc;
+            const TaggedValue& m = tagged;
+            for(size_t i = 0; i < m.size(); ++i) {
+                accumulateTagged(acc, m.at(i));
+            }
+            return acc.sum;
+        });
+    }
+    
+    // --- Map::visit(k), lookup of single keys ---
+    {
+        std::vector<std::pair<const std::string, GenericValueHolder>> entries;
+        std::unordered_map<std::string, GenericValueHolder> raw;
+        std::string keyBuffer;
+        for(size_t i = 0; i < mapCount; ++i) {
+            const std::string key = "key" + std::to_string(i);
+            forBenchmarkScalar(i, [&](auto v){
+                entries.emplace_back(key, v);
+                raw.emplace(key, v);
+            });
+            keyBuffer += key;
+            keyBuffer += ',';
+        }
+        Map<> map(entries.begin(), entries.end());
+        
+        // Keys are slices of one buffer, as they would be from a parsed request
+        std::vector<std::string_view> keys;
+        for(size_t pos = 0, next; (next = keyBuffer.find(',', pos)) != std::string::npos; pos = next + 1) {
+            keys.emplace_back(std::string_view(keyBuffer).substr(pos, next - pos));
+        }
+        
+        runBenchmark("lookup", "crtp", keys.size(), [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            for(const auto& k: keys) {
+                map.visit(k, viewer);
+            }
+            return acc.sum;
+        });
+        // Read overhead of a snapshot against a mutex around the map, without concurrent writers
+        SnapshotMap<> snapshot(Map<>(entries.begin(), entries.end()));
+        runBenchmark("lookup", "snapshot", keys.size(), [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            for(const auto& k: keys) {
+                snapshot.visit(k, viewer);
+            }
+            return acc.sum;
+        });
+        std::mutex mapMutex;
+        runBenchmark("lookup", "mutex", keys.size(), [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<MapIndexType>>([&acc](MapIndexType, const auto& v){ acc(v); return true; });
+            for(const auto& k: keys) {
+                std::lock_guard<std::mutex> lock(mapMutex);
+                map.visit(k, viewer);
+            }
+            return acc.sum;
+        });
+        runBenchmark("lookup", "std-visit", keys.size(), [&]() {
+            BenchmarkAccumulator acc;
+            for(const auto& k: keys) {
+                auto it = raw.find(std::string(k));
+                if(it == raw.end()) continue;
+                std::visit([&acc](const auto& v){
+                    if constexpr (std::is_arithmetic_v<decay_t<decltype(v)>>) acc(v);
+                }, it->second);
+            }
+            return acc.sum;
+        });
+    }
+    
+    // --- List::iterate ---
+    {
+        std::vector<GenericValueHolder> raw;
+        TaggedNode tagged(TaggedType::List);
+        for(size_t i = 0; i < listCount; ++i) {
+            forBenchmarkScalar(i, [&](auto v){
+                raw.emplace_back(v);
+                tagged.append(std::make_unique<TaggedNode>(v));
+            });
+        }
+        List<> list(raw.begin(), raw.end());
+        
+        runBenchmark("list", "virtual", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            ((const ViewableListValue&) list).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+        runBenchmark("list", "flat", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<FlatValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            iterateFlat((const ViewableListValue&) list, viewer);
+            return acc.sum;
+        });
+        runBenchmark("list", "crtp", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            list.iterate(viewer);
+            return acc.sum;
+        });
+        runBenchmark("list", "cursor", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            for(auto c = cursor(list); !c.done(); ++c) {
+                c.visit(viewer);
+            }
+            return acc.sum;
+        });
+        ThreadPool pool;
+        runBenchmark("list", "parallel", listCount, [&]() {
+            auto viewer = freeVisitor<ScalarValueViewer<ListIndexType>>(NumberStatistics{});
+            parallelIterate(pool, list, viewer, [](auto& result, const auto& clone) {
+                result.sum += clone.sum;
+            });
+            return viewer.sum;
+        });
+        runBenchmark("list", "std-visit", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            for(const auto& v: raw) {
+                std::visit([&acc](const auto& v){
+                    if constexpr (std::is_arithmetic_v<decay_t<decltype(v)>>) acc(v);
+                }, v);
+            }
+            return acc.sum;
+        });
+        runBenchmark("list", "tag-switch", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            const TaggedValue& l = tagged;
+            for(size_t i = 0; i < l.size(); ++i) {
+                accumulateTagged(acc, l.at(i));
+            }
+            return acc.sum;
+        });
+    }
+    
+    // --- List::iterate with 16 byte CompactValue cells ---
+    {
+        std::vector<CompactValue> raw;
+        for(size_t i = 0; i < listCount; ++i) {
+            forBenchmarkScalar(i, [&](auto v){
+                raw.emplace_back(v);
+            });
+        }
+        List<CompactValue> list(raw.begin(), raw.end());
+        
+        runBenchmark("list", "compact", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            ((const ViewableListValue&) list).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+    }
+    
+    // --- List::iterate over a homogeneous list, with and without batch interface ---
+    {
+        std::vector<GenericValueHolder> raw;
+        for(size_t i = 0; i < listCount; ++i) {
+            raw.emplace_back(0.5 * i);
+        }
+        List<> list(raw.begin(), raw.end());
+        
+        runBenchmark("homog-list", "virtual", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            ((const ViewableListValue&) list).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+        runBenchmark("homog-list", "batched", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = composedVisitor<VisitorGroup<ValueViewer<ListIndexType>, BatchValueViewer<ListIndexType>>>(
+                freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; }),
+                freeVisitor<BatchValueViewer<ListIndexType>>([&acc](ListIndexRange, auto v){ 
+                    for(size_t i = 0; i < v.size; ++i) acc(v.data[i]);
+                    return true;
+                }));
+            ((const ViewableListValue&) list).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+        
+        std::vector<double> values;
+        for(size_t i = 0; i < listCount; ++i) {
+            values.push_back(0.5 * i);
+        }
+        ColumnList<double> column(std::move(values));
+        runBenchmark("homog-list", "column", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; });
+            ((const ViewableListValue&) column).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+        runBenchmark("homog-list", "col-batched", listCount, [&]() {
+            BenchmarkAccumulator acc;
+            auto viewer = composedVisitor<VisitorGroup<ValueViewer<ListIndexType>, BatchValueViewer<ListIndexType>>>(
+                freeVisitor<ValueViewer<ListIndexType>>([&acc](ListIndexType, const auto& v){ acc(v); return true; }),
+                freeVisitor<BatchValueViewer<ListIndexType>>([&acc](ListIndexRange, auto v){ 
+                    for(size_t i = 0; i < v.size; ++i) acc(v.data[i]);
+                    return true;
+                }));
+            ((const ViewableListValue&) column).iterate((ValueViewer<ListIndexType>&) viewer);
+            return acc.sum;
+        });
+    }
+    
+    // --- Building and dropping the nested document, shared_ptr nodes against one arena for nodes, entries and keys ---
+    {
+        runBenchmark("build", "shared", benchmarkNodes, [&]() {
+            SharedNodeFactory factory;
+            auto root = makeBenchmarkTree<GenericValueHolder>(factory);
+            return (double) root->size();
+        });
+        runBenchmark("build", "arena", benchmarkNodes, [&]() {
+            Document doc;
+            doc.setRoot(makeBenchmarkTree<DocumentValueHolder>(doc));
+            return (double) doc.root().size();
+        });
+    }
+    
+    // --- Reading JSON, events only against building the tree ---
+    {
+        const size_t records = 1000;
+        std::string text = "[";
+        for(size_t i = 0; i < records; ++i) {
+            if(i > 0) text += ",";
+            text += "{\"id\": " + std::to_string(i) + ", \"name\": \"item " + std::to_string(i) + "\", \"values\": [" 
+                + std::to_string(i) + ", " + std::to_string(i + 1) + ", " + std::to_string(i + 2) + "]}";
+        }
+        text += "]";
+        const size_t leaves = records * 5;
+        
+        struct CountingHandler {
+            size_t count = 0;
+            bool null() { ++count; return true; }
+            bool boolean(bool) { ++count; return true; }
+            bool integer(long) { ++count; return true; }
+            bool real(double) { ++count; return true; }
+            bool string(std::string_view) { ++count; return true; }
+            bool startObject() { return true; }
+            bool key(std::string_view) { return true; }
+            bool endObject() { return true; }
+            bool startArray() { return true; }
+            bool endArray() { return true; }
+        };
+        runBenchmark("json", "events", leaves, [&]() {
+            JsonReader reader(text);
+            CountingHandler handler;
+            reader.parse(handler);
+            return (double) handler.count;
+        });
+        runBenchmark("json", "tree", leaves, [&]() {
+            std::optional<GenericValueHolder> root;
+            readJson(text, root);
+            return (double) root.has_value();
+        });
+        // One record of the document is read
+        auto idViewer = freeVisitor<NumericValueViewer<MapIndexType>>([](MapIndexType, auto v) -> bool {
+            benchmarkSink = benchmarkSink + (double) v;
+            return true;
+        });
+        auto recordViewer = freeVisitor<MapValueViewer<ListIndexType>>([&idViewer](ListIndexType, const ViewableMapValue& record) -> bool {
+            record.visit("id", idViewer);
+            return true;
+        });
+        runBenchmark("json", "tree-one", leaves, [&]() {
+            std::optional<GenericValueHolder> root;
+            readJson(text, root);
+            std::get<std::shared_ptr<ViewableListValue>>(*root)->visit(records / 2, recordViewer);
+            return (double) root.has_value();
+        });
+        runBenchmark("json", "lazy-one", leaves, [&]() {
+            std::optional<GenericValueHolder> root;
+            readJsonLazy(text, root);
+            std::get<std::shared_ptr<ViewableListValue>>(*root)->visit(records / 2, recordViewer);
+            return (double) root.has_value();
+        });
+    }
+    
+    // --- Deep lookups in the nested document: one visitor per level against compiled paths ---
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        const size_t lookups = 32;
+        std::vector<std::string> sectionKeys;
+        std::vector<CompiledPath> paths;
+        for(size_t i = 0; i < lookups; ++i) {
+            sectionKeys.push_back("s" + std::to_string(i * 2));
+            paths.emplace_back("s" + std::to_string(i * 2) + ".items[" + std::to_string(i) + "].b");
+        }
+        auto valueViewer = freeVisitor<ValueViewer<MapIndexType>>([](MapIndexType, const auto& v) -> bool {
+            if constexpr (std::is_arithmetic_v<decay_t<decltype(v)>>) benchmarkSink = benchmarkSink + (double) v;
+            return true;
+        });
+        runBenchmark("path", "nested", lookups, [&]() {
+            for(size_t i = 0; i < lookups; ++i) {
+                auto itemViewer = freeVisitor<MapValueViewer<ListIndexType>>([&valueViewer](ListIndexType, const ViewableMapValue& item) -> bool {
+                    item.visit("b", valueViewer);
+                    return true;
+                });
+                auto itemsViewer = freeVisitor<ListValueViewer<MapIndexType>>([&itemViewer, i](MapIndexType, const ViewableListValue& items) -> bool {
+                    items.visit((ListIndexType) i, itemViewer);
+                    return true;
+                });
+                auto sectionViewer = freeVisitor<MapValueViewer<MapIndexType>>([&itemsViewer](MapIndexType, const ViewableMapValue& section) -> bool {
+                    section.visit("items", itemsViewer);
+                    return true;
+                });
+                ((const ViewableMapValue&) *doc.map).visit(sectionKeys[i], sectionViewer);
+            }
+            return benchmarkSink;
+        });
+        runBenchmark("path", "compiled", lookups, [&]() {
+            for(const auto& path: paths) path.resolve(*doc.map, valueViewer);
+            return benchmarkSink;
+        });
+    }
+    
+    // --- Comparing the nested document with an equal copy: hashing all values against cached fingerprints, per comparison ---
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        BenchmarkDocument copy = makeBenchmarkDocument();
+        const std::string binary = encodeBinary(*doc.map);
+        BinaryDocument document;
+        document.load(binary);
+        runBenchmark("equal", "hashed", 1, [&]() {
+            return (double) (computeFingerprint(*document.rootMap()) == structuralFingerprint(*copy.map));
+        });
+        runBenchmark("equal", "cached", 1, [&]() {
+            return (double) sameStructure<ViewableMapValue>(*doc.map, *copy.map);
+        });
+    }
+    
+    // --- Diff of the nested document against a copy with one changed leaf: without and with cached fingerprints, per diff ---
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        BenchmarkDocument copy = makeBenchmarkDocument();
+        ChangeSet<> change;
+        change.push_back(Change<>{ChangeKind::ValueChanged, CompiledPath("s7.items[3].b"), GenericValueHolder(99.0)});
+        patchTree(*copy.map, std::move(change));
+        const std::string binary = encodeBinary(*doc.map);
+        const std::string binaryCopy = encodeBinary(*copy.map);
+        BinaryDocument document;
+        BinaryDocument documentCopy;
+        document.load(binary);
+        documentCopy.load(binaryCopy);
+        runBenchmark("diff", "hashed", 1, [&]() {
+            return (double) diffTrees(*document.rootMap(), *documentCopy.rootMap()).size();
+        });
+        runBenchmark("diff", "cached", 1, [&]() {
+            return (double) diffTrees(*doc.map, *copy.map).size();
+        });
+    }
+    
+    // --- Building a list of rows with string and array payloads: initializer_list copies against moves into builders ---
+    {
+        const size_t rowCount = 1 << 10;
+        const std::string name = "a name which does not fit into the small string buffer";
+        runBenchmark("rows", "init-list", rowCount, [&]() {
+            std::vector<GenericValueHolder> rows;
+            rows.reserve(rowCount);
+            for(size_t i = 0; i < rowCount; ++i) {
+                rows.emplace_back(std::make_shared<Map<>>(Map<>{
+                    { {"id", (long) i}
+                    , {"name", std::string(name)}
+                    , {"readings", std::vector<double>(16, 0.5 * i)}
+                    }}));
+            }
+            return (double) List<>(std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end())).size();
+        });
+        runBenchmark("rows", "builder", rowCount, [&]() {
+            return (double) ListBuilder<>(rowCount).generate(rowCount, [&name](size_t i) {
+                return MapBuilder<>(3).emplace("id", (long) i).emplace("name", std::string(name)).emplace("readings", std::vector<double>(16, 0.5 * i)).buildShared();
+            }).build().size();
+        });
+    }
+    
+    // --- Making a received array visitable: copying it into std::vector against adopting it as ExternalArray, per array ---
+    {
+        const size_t sampleCount = 1 << 20;
+        const std::vector<double> received(sampleCount, 0.5);
+        runBenchmark("adopt", "copy", 1, [&]() {
+            Value<> samples(std::vector<double>(received.begin(), received.end()));
+            return 1.0;
+        });
+        runBenchmark("adopt", "external", 1, [&]() {
+            Value<> samples(ExternalArray<double>(received.data(), received.size(), [](const double*, size_t) {}));
+            return 1.0;
+        });
+    }
+    
+    // --- Opening the nested document: parsing JSON against validating the binary format in place ---
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        const std::string json = writeJson(*doc.map);
+        const std::string binary = encodeBinary(*doc.map);
+        const std::string msgpack = writeMsgPack(*doc.map);
+        runBenchmark("open", "json", benchmarkNestedLeaves, [&]() {
+            std::optional<GenericValueHolder> root;
+            readJson(json, root);
+            return (double) root.has_value();
+        });
+        runBenchmark("open", "binary", benchmarkNestedLeaves, [&]() {
+            BinaryDocument document;
+            return (double) document.load(binary);
+        });
+        runBenchmark("open", "msgpack", benchmarkNestedLeaves, [&]() {
+            std::optional<GenericValueHolder> root;
+            readMsgPack(msgpack, root);
+            return (double) root.has_value();
+        });
+    }
+    
+    // --- Writing the nested document, ValueWriter against std::ostream formatting ---
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        OutputBuffer out;
+        runBenchmark("write", "json", benchmarkNestedLeaves, [&]() {
+            out.clear();
+            ValueWriter<>(out, WriteFormat::Json).write(*doc.map);
+            return (double) out.str().size();
+        });
+        runBenchmark("write", "text", benchmarkNestedLeaves, [&]() {
+            out.clear();
+            ValueWriter<>(out, WriteFormat::Text).write(*doc.map);
+            return (double) out.str().size();
+        });
+        std::string packed;
+        runBenchmark("write", "msgpack", benchmarkNestedLeaves, [&]() {
+            packed.clear();
+            MsgPackWriter(packed).write(*doc.map);
+            return (double) packed.size();
+        });
+        runBenchmark("write", "ostream", benchmarkNestedLeaves, [&]() {
+            std::ostringstream stream;
+            auto viewer = recursiveViewer([&stream](const TraversalContext& context, const auto& v) -> bool {
+                using T = decay_t<decltype(v)>;
+                if constexpr (std::is_base_of_v<ViewableMapValue, T> || std::is_base_of_v<ViewableListValue, T>) {
+                    stream << std::string(context.depth() * 2, ' ') << "{" << std::endl;
+                }
+                else if constexpr (std::is_arithmetic_v<T> || std::is_convertible_v<T, std::string_view>) {
+                    stream << std::string(context.depth() * 2, ' ') << v << std::endl;
+                }
+                else {
+                    for(size_t i = 0; i < v.size; ++i) stream << +v.data[i] << " ";
+                    stream << std::endl;
+                }
+                return true;
+            });
+            viewer.traverse(*doc.map);
+            return (double) stream.tellp();
+        });
+    }
+    
+    // --- Nested traversal ---
+    // Nested containers are always reached through the abstract interfaces, 
+    // so the crtp path only differs at the root.
+    {
+        BenchmarkDocument doc = makeBenchmarkDocument();
+        
+        withNestedBenchmarkViewers<ValueViewer>([&](BenchmarkAccumulator& acc, auto& mapViewer) {
+            runBenchmark("nested", "virtual", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                ((const ViewableMapValue&) *doc.map).iterate((ValueViewer<MapIndexType>&) mapViewer);
+                return acc.sum;
+            });
+            runBenchmark("nested", "crtp", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                doc.map->iterate(mapViewer);
+                return acc.sum;
+            });
+        });
+        {
+            BenchmarkAccumulator acc;
+            auto viewer = recursiveViewer([&acc](const TraversalContext&, const auto& v) -> bool {
+                using T = decay_t<decltype(v)>;
+                if constexpr (!std::is_base_of_v<ViewableMapValue, T> && !std::is_base_of_v<ViewableListValue, T>) {
+                    acc(v);
+                }
+                return true;
+            });
+            runBenchmark("nested", "recursive", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                viewer.traverse(*doc.map);
+                return acc.sum;
+            });
+        }
+        {
+            ThreadPool pool;
+            runBenchmark("nested", "par-tree", benchmarkNestedLeaves, [&]() {
+                BenchmarkTreeAccumulator result = parallelTraverse(pool, *doc.map, BenchmarkTreeAccumulator{}, [](BenchmarkTreeAccumulator& into, const BenchmarkTreeAccumulator& from) {
+                    into.acc.sum += from.acc.sum;
+                    into.acc.count += from.acc.count;
+                });
+                return result.acc.sum;
+            });
+        }
+        Document arenaDoc;
+        arenaDoc.setRoot(makeBenchmarkTree<DocumentValueHolder>(arenaDoc));
+        withNestedBenchmarkViewers<ValueViewer>([&](BenchmarkAccumulator& acc, auto& mapViewer) {
+            runBenchmark("nested", "arena", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                ((const ViewableMapValue&) arenaDoc.root()).iterate((ValueViewer<MapIndexType>&) mapViewer);
+                return acc.sum;
+            });
+        });
+        const std::string encoded = encodeBinary(*doc.map);
+        BinaryDocument binaryDoc;
+        binaryDoc.load(encoded);
+        withNestedBenchmarkViewers<ValueViewer>([&](BenchmarkAccumulator& acc, auto& mapViewer) {
+            runBenchmark("nested", "binary", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                ((const ViewableMapValue&) *binaryDoc.rootMap()).iterate((ValueViewer<MapIndexType>&) mapViewer);
+                return acc.sum;
+            });
+        });
+        withNestedBenchmarkViewers<FlatValueViewer>([&](BenchmarkAccumulator& acc, auto& mapViewer) {
+            runBenchmark("nested", "flat", benchmarkNestedLeaves, [&]() {
+                acc = BenchmarkAccumulator{};
+                iterateFlat((const ViewableMapValue&) *doc.map, mapViewer);
+                return acc.sum;
+            });
+        });
+        runBenchmark("nested", "std-visit", benchmarkNestedLeaves, [&]() {
+            BenchmarkAccumulator rawAcc;
+            accumulateRaw(rawAcc, doc.raw);
+            return rawAcc.sum;
+        });
+        runBenchmark("nested", "tag-switch", benchmarkNestedLeaves, [&]() {
+            BenchmarkAccumulator taggedAcc;
+            accumulateTagged(taggedAcc, *doc.tagged);
+            return taggedAcc.sum;
+        });
+    }
+    
+    return 0;
+}
+#endif // RUN_BENCHMARK
+
+
+//-----------------------------------------------------------------------------
+// Layout report: sizeof, vptr count and vtable entries of all Visitor/VisitorGroup/Visitable combinations
+//
+// Build and run with `make layout`. The vptr count and vtable entries are taken from the class 
+// hierarchy dump of gcc (-fdump-lang-class), which is passed as first argument.
+// The report fails (exit code 1) as soon as any type exceeds its byte budget.
+// Budgets are given for LP64 with the Itanium C++ ABI (gcc/clang on Linux), 0 means no budget.
+//-----------------------------------------------------------------------------
+#ifdef LAYOUT_REPORT
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+class LayoutReport {
+private:
+    std::string dump_;
+    bool failed_ = false;
+    
+    // Count the vptrs referring to the vtable group of the class
+    long countVptrs(const std::string& vtableSymbol) const {
+        if(dump_.empty()) return -1;
+        const std::string pattern = "::" + vtableSymbol + ") + ";
+        long count = 0;
+        for(size_t pos = dump_.find(pattern); pos != std::string::npos; pos = dump_.find(pattern, pos + 1)) {
+            size_t lineStart = dump_.rfind('\n', pos);
+            lineStart = lineStart == std::string::npos ? 0 : lineStart;
+            if(dump_.find("vptr=((& ", lineStart) < pos) {
+                ++count;
+            }
+        }
+        return count;
+    }
+    
+    long countVtableEntries(const std::string& vtableSymbol) const {
+        if(dump_.empty()) return -1;
+        const std::string pattern = "::" + vtableSymbol + ": ";
+        size_t pos = dump_.find(pattern);
+        if(pos == std::string::npos) return -1;
+        return std::strtol(dump_.c_str() + pos + pattern.size(), nullptr, 10);
+    }
+    
+public:
+    LayoutReport(const char* dumpFile) {
+        if(dumpFile == nullptr) return;
+        std::ifstream in(dumpFile);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        dump_ = buffer.str();
+        if(dump_.empty()) {
+            std::fprintf(stderr, "Can not read class hierarchy dump %s, vptrs and vtable entries are not reported\n", dumpFile);
+        }
+    }
+    
+    void header(const char* section) const {
+        std::printf("\n%-56s %7s %6s %8s %7s\n", section, "sizeof", "vptrs", "entries", "budget");
+    }
+    
+    template<typename T>
+    void add(const char* name, size_t budget) {
+        const std::string vtableSymbol = std::string("_ZTV") + typeid(T).name();
+        const long vptrs = countVptrs(vtableSymbol);
+        const long entries = countVtableEntries(vtableSymbol);
+        const bool exceeded = budget != 0 && sizeof(T) > budget;
+        failed_ = failed_ || exceeded;
+        
+        std::printf("%-56s %7zu ", name, sizeof(T));
+        if(vptrs >= 0) std::printf("%6ld ", vptrs); else std::printf("%6s ", "-");
+        if(entries >= 0) std::printf("%8ld ", entries); else std::printf("%8s ", "-");
+        if(budget != 0) std::printf("%7zu", budget); else std::printf("%7s", "-");
+        std::printf("%s\n", exceeded ? "  EXCEEDED" : "");
+    }
+    
+    bool failed() const { return failed_; }
+};
+
+// Functor to generate free visitors for the report
+struct LayoutNoopHandler {
+    template<typename ...Ts>
+    bool operator()(Ts&&...) const { return true; }
+};
+
+template<typename IndexType>
+void reportViewerLayouts(LayoutReport& report, const char* index, size_t (&budgets)[15]) {
+    std::string suffix = std::string("<") + index + ">";
+    report.header((std::string("Viewers") + suffix).c_str());
+    report.add<IntegralValueViewer<IndexType>>(          ("IntegralValueViewer" + suffix).c_str(),           budgets[0]);
+    report.add<FloatingValueViewer<IndexType>>(          ("FloatingValueViewer" + suffix).c_str(),           budgets[1]);
+    report.add<NumericValueViewer<IndexType>>(           ("NumericValueViewer" + suffix).c_str(),            budgets[2]);
+    report.add<StringValueViewer<IndexType>>(            ("StringValueViewer" + suffix).c_str(),             budgets[3]);
+    report.add<ScalarValueViewer<IndexType>>(            ("ScalarValueViewer" + suffix).c_str(),             budgets[4]);
+    report.add<IntegralContiguousValueViewer<IndexType>>(("IntegralContiguousValueViewer" + suffix).c_str(), budgets[5]);
+    report.add<FloatingContiguousValueViewer<IndexType>>(("FloatingContiguousValueViewer" + suffix).c_str(), budgets[6]);
+    report.add<NumericContiguousValueViewer<IndexType>>( ("NumericContiguousValueViewer" + suffix).c_str(),  budgets[7]);
+    report.add<BinaryContiguousValueViewer<IndexType>>(  ("BinaryContiguousValueViewer" + suffix).c_str(),   budgets[8]);
+    report.add<ContiguousValueViewer<IndexType>>(        ("ContiguousValueViewer" + suffix).c_str(),         budgets[9]);
+    report.add<MapValueViewer<IndexType>>(               ("MapValueViewer" + suffix).c_str(),                budgets[10]);
+    report.add<ListValueViewer<IndexType>>(              ("ListValueViewer" + suffix).c_str(),               budgets[11]);
+    report.add<ContainerValueViewer<IndexType>>(         ("ContainerValueViewer" + suffix).c_str(),          budgets[12]);
+    report.add<ValueViewer<IndexType>>(                  ("ValueViewer" + suffix).c_str(),                   budgets[13]);
+    report.add<FlatValueViewer<IndexType>>(              ("FlatValueViewer" + suffix).c_str(),               budgets[14]);
+}
+
+template<typename IndexType>
+void reportViewableLayouts(LayoutReport& report, const char* index, size_t (&budgets)[7]) {
+    std::string suffix = std::string("<") + index + ">";
+    report.header((std::string("Viewables") + suffix).c_str());
+    report.add<Viewable<IndexType, NumericValueViewer<IndexType>>>(   ("Viewable<NumericValueViewer" + suffix + ">").c_str(),    budgets[0]);
+    report.add<Viewable<IndexType, ScalarValueViewer<IndexType>>>(    ("Viewable<ScalarValueViewer" + suffix + ">").c_str(),     budgets[1]);
+    report.add<Viewable<IndexType, NumericContiguousValueViewer<IndexType>>>(("Viewable<NumericContiguousValueViewer" + suffix + ">").c_str(), budgets[2]);
+    report.add<Viewable<IndexType, ContiguousValueViewer<IndexType>>>(("Viewable<ContiguousValueViewer" + suffix + ">").c_str(), budgets[3]);
+    report.add<Viewable<IndexType, ContainerValueViewer<IndexType>>>( ("Viewable<ContainerValueViewer" + suffix + ">").c_str(),  budgets[4]);
+    report.add<Viewable<IndexType, ValueViewer<IndexType>>>(          ("Viewable<ValueViewer" + suffix + ">").c_str(),           budgets[5]);
+    report.add<Viewable<IndexType, FlatValueViewer<IndexType>>>(      ("Viewable<FlatValueViewer" + suffix + ">").c_str(),       budgets[6]);
+}
+
+inline int runLayoutReport(const char* dumpFile) {
+    LayoutReport report(dumpFile);
+    
+    // Budgets in bytes, in order of the report
+    size_t viewerBudgets[15]   = {8, 8, 16, 8, 24, 8, 8, 16, 8, 24, 8, 8, 16, 64, 8};
+    size_t viewableBudgets[7]  = {16, 24, 16, 24, 16, 64, 8};
+    
+    reportViewerLayouts<void>(report, "void", viewerBudgets);
+    reportViewerLayouts<MapIndexType>(report, "MapIndexType", viewerBudgets);
+    reportViewerLayouts<ListIndexType>(report, "ListIndexType", viewerBudgets);
+    
+    reportViewableLayouts<void>(report, "void", viewableBudgets);
+    reportViewableLayouts<MapIndexType>(report, "MapIndexType", viewableBudgets);
+    reportViewableLayouts<ListIndexType>(report, "ListIndexType", viewableBudgets);
+    
+    report.header("Implementations");
+    report.add<ViewableMapValue>("ViewableMapValue", 64);
+    report.add<ViewableListValue>("ViewableListValue", 64);
+    report.add<TestViewable>("TestViewable", 64);
+    report.add<TestViewer>("TestViewer", 64);
+    report.add<FreeVisitor<ValueViewer<void>, LayoutNoopHandler>>("FreeVisitor<ValueViewer<void>>", 160);
+    report.add<FreeVisitor<ValueViewer<MapIndexType>, LayoutNoopHandler>>("FreeVisitor<ValueViewer<MapIndexType>>", 160);
+    report.add<FreeVisitor<ValueViewer<ListIndexType>, LayoutNoopHandler>>("FreeVisitor<ValueViewer<ListIndexType>>", 160);
+    report.add<FreeVisitor<FlatValueViewer<void>, LayoutNoopHandler>>("FreeVisitor<FlatValueViewer<void>>", 8);
+    report.add<FreeVisitor<FlatValueViewer<MapIndexType>, LayoutNoopHandler>>("FreeVisitor<FlatValueViewer<MapIndexType>>", 8);
+    report.add<FreeVisitor<FlatValueViewer<ListIndexType>, LayoutNoopHandler>>("FreeVisitor<FlatValueViewer<ListIndexType>>", 8);
+    report.add<FreeVisitor<FlatValueEditor<void>, LayoutNoopHandler>>("FreeVisitor<FlatValueEditor<void>>", 8);
+    report.add<FreeVisitor<FlatValueEditor<MapIndexType>, LayoutNoopHandler>>("FreeVisitor<FlatValueEditor<MapIndexType>>", 8);
+    report.add<FreeVisitor<FlatValueEditor<ListIndexType>, LayoutNoopHandler>>("FreeVisitor<FlatValueEditor<ListIndexType>>", 8);
+    // Returned by flat(), a container and a function table pointer
+    report.add<FlatView<void>>("FlatView<void>", 16);
+    report.add<FlatView<MapIndexType>>("FlatView<MapIndexType>", 16);
+    report.add<FlatView<ListIndexType>>("FlatView<ListIndexType>", 16);
+    // Returned by editable(), like FlatView
+    report.add<EditableValue>("EditableValue", 16);
+    report.add<EditableMapValue>("EditableMapValue", 16);
+    report.add<EditableListValue>("EditableListValue", 16);
+    // The containers carry a fingerprint cache of one pointer
+    report.add<Value<>>("Value<>", 128);
+    report.add<Map<>>("Map<>", 144);
+    report.add<List<>>("List<>", 120);
+    report.add<BinaryMapValue>("BinaryMapValue", 112);
+    report.add<BinaryListValue>("BinaryListValue", 112);
+    
+    report.header("Value cells");
+    report.add<GenericValueHolder>("GenericValueHolder", 0);
+    report.add<DocumentValueHolder>("DocumentValueHolder", 0);
+    report.add<CompactValue>("CompactValue", 16);
+    
+    std::fflush(stdout);
+    if(report.failed()) {
+        std::fprintf(stderr, "\nLayout budget exceeded\n");
+        return 1;
+    }
+    return 0;
+}
+#endif // LAYOUT_REPORT
+
 #endif
 
 
  
-int main()
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
 {   
+#if defined(RUN_BENCHMARK) && __cplusplus >= 201703L
+    return runBenchmarks();
+#endif
+#if defined(LAYOUT_REPORT) && __cplusplus >= 201703L
+    return runLayoutReport(argc > 1 ? argv[1] : nullptr);
+#endif
     testExample1();
 #if __cplusplus >= 201703L
     testGenericValue();